@@ -4,6 +4,16 @@
 #include <limits>
 #include <algorithm>
 #include <chrono>
+#include <new>
+#include <cassert>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+#include <random>
 
 struct Edge
 {	// edge between nodes u and v with weight w
@@ -11,52 +21,45 @@ struct Edge
 };
 
 class SquareMatrix	
-{	
+{	// N x N doubles in a single block, rows are padded to stride elements, a multiple of tile, and the block starts on a cache line
+	// so a tile of tile x tile elements starts on a cache line too, as tiles are multiples of 8 doubles, and padding elements are set to the initial value
 	public:
-	SquareMatrix(size_t N)	:	_N{N}
-	{	// constructor 
-		_elements = new double*[_N];
-		for(size_t i=0; i<_N; ++i)
-		{
-			_elements[i] = new double[_N];
-		}
-	}
-	SquareMatrix(size_t N, double v)	:	_N{N}
+	static constexpr size_t alignment = 64;
+	SquareMatrix(size_t N, double v, size_t tile)	:	_N{N}, _stride{(N + tile - 1) / tile * tile}, 
+											_elements{static_cast<double*>(::operator new[](_stride * _stride * sizeof(double), std::align_val_t{alignment}))}
 	{	// constructor with initial value
-		_elements = new double*[_N];
-		for(size_t i=0; i<_N; ++i)
-		{
-			_elements[i] = new double[_N];
-			std::fill_n(_elements[i], _N, v);
-		}		
+		std::fill_n(_elements, _stride * _stride, v);
 	}
 	// delete copy constructor and assignment operator
 	SquareMatrix(const SquareMatrix&) = delete;
 	SquareMatrix& operator=(const SquareMatrix&) = delete;
 	double& operator()(size_t i, size_t j)
 	{	// for indexing 
-		return _elements[i][j];
+		return _elements[i * _stride + j];
 	}
 	const double& operator()(size_t i, size_t j) const
 	{	// for indexing
-		return _elements[i][j];
+		return _elements[i * _stride + j];
 	}
-	static void swap(SquareMatrix& lhs, SquareMatrix& rhs)
-	{	// swaps two SquareMatrix obj in O(1) due pointers
-		std::swap(lhs._elements, rhs._elements);
-		std::swap(lhs._N, rhs._N);
+	size_t stride() const
+	{	// number of rows and columns including padding
+		return _stride;
+	}
+	double* data()
+	{
+		return _elements;
 	}
 	double min_nondiagonal() const
 	{	// finds shortest shortest path distance
 		// runs in O(n^2) time
 		double shortest_path_distance = std::numeric_limits<double>::infinity();
-		for(long long i=1; i<_N; ++i)
+		for(size_t i=1; i<_N; ++i)
 		{
-			for(long long j=1; j<_N; ++j)
+			for(size_t j=1; j<_N; ++j)
 			{
-				if(i != j && shortest_path_distance > _elements[i][j])
+				if(i != j && shortest_path_distance > (*this)(i, j))
 				{	// i != j prevents the chance of returing 0
-					shortest_path_distance = _elements[i][j];
+					shortest_path_distance = (*this)(i, j);
 				}
 			}
 		}
@@ -64,63 +67,410 @@ class SquareMatrix
 	}
 	~SquareMatrix()
 	{	// destructor
-		for(size_t i=0; i<_N; ++i)
+		::operator delete[](_elements, std::align_val_t{alignment});
+	}
+	private:
+	size_t _N;
+	size_t _stride;
+	double* _elements;
+};
+
+template<size_t MaxV>
+class NextHops
+{	// next(i, j) is the vertex after i on a shortest path from i to j, or none when there is no path
+	// length(i, j) is the number of edges of that path, among shortest paths the one with the fewest edges is kept,
+	// otherwise ties around a zero weight cycle could make next hops go around it forever
+	// vertices and lengths are stored in 16 bits when MaxV allows it and in 32 bits otherwise, the largest value being none,
+	// so with the distances, floyd_warshall takes stride x stride x (8 + 2 x sizeof(Hop)) bytes, stride being V + 1 rounded up to tile
+	public:
+	static_assert(MaxV < std::numeric_limits<uint32_t>::max(), "vertices are stored in at most 32 bits");
+	using Hop = std::conditional_t<(MaxV < std::numeric_limits<uint16_t>::max()), uint16_t, uint32_t>;
+	static constexpr Hop none = std::numeric_limits<Hop>::max();
+	void reset(const size_t V, const size_t stride)
+	{	// no paths between V vertices, in rows of stride elements as the distances
+		assert(V <= MaxV && "too many vertices for this next hop matrix");
+		_V = V;
+		_stride = stride;
+		_negative_cycle = false;
+		_hops.assign(stride * stride, none);
+		_lengths.assign(stride * stride, none);
+	}
+	Hop& operator()(size_t i, size_t j)
+	{
+		return _hops[i * _stride + j];
+	}
+	Hop& length(size_t i, size_t j)
+	{
+		return _lengths[i * _stride + j];
+	}
+	Hop* data()
+	{
+		return _hops.data();
+	}
+	Hop* length_data()
+	{
+		return _lengths.data();
+	}
+	void set_negative_cycle()
+	{	// next hops are meaningless when there is a negative cycle
+		_negative_cycle = true;
+	}
+	bool negative_cycle() const
+	{
+		return _negative_cycle;
+	}
+	size_t bytes() const
+	{	// memory taken by the next hops and the lengths
+		return (_hops.size() + _lengths.size()) * sizeof(Hop);
+	}
+	std::vector<long long> path(long long u, const long long v) const
+	{	// vertices of a shortest path from u to v, empty when there is none
+		// a simple path has at most V vertices, more mean that the hops are broken, as they are after a negative cycle
+		std::vector<long long> vertices;
+		if(_negative_cycle == true || _hops[u * _stride + v] == none)		return vertices;
+		vertices.push_back(u);
+		while(u != v)
 		{
-			delete[] _elements[i];
+			u = _hops[u * _stride + v];
+			vertices.push_back(u);
+			if(vertices.size() > _V)		return {};
 		}
-		delete[] _elements;
+		return vertices;
 	}
 	private:
-	double** _elements;
-	size_t _N;
+	size_t _V = 0;
+	size_t _stride = 0;
+	bool _negative_cycle = false;
+	std::vector<Hop> _hops;
+	std::vector<Hop> _lengths;
+};
+
+template<size_t tile>
+void relax_tile(double* c, const double* a, const double* b, const size_t stride)
+{	// c(i, j) = min(c(i, j), a(i, k) + b(k, j)) for k, i and j in [0, tile), one fw step for each k in the order of k
+	// tiles are given by their first elements in a matrix with the given stride
+	// the inner loop is a min of sums over contiguous doubles, which the compiler turns into vector instructions;
+	// std::min(x, y) returns x unless y < x, as the vector minimum does, so no fast-math flag is needed
+	// at -O2 gcc only vectorizes loops whose trip count is a known multiple of the vector length, so tile is a template parameter
+	// c may be the same tile as a or b, but iteration j only reads and writes column j, so iterations are independent,
+	// ivdep tells that to the compiler, which would otherwise not vectorize at -O2 for fear of overlapping rows
+	for(size_t k=0; k<tile; ++k)
+	{
+		const double* b_row = b + k * stride;
+		for(size_t i=0; i<tile; ++i)
+		{
+			double* c_row = c + i * stride;
+			const double a_ik = a[i * stride + k];
+			#pragma GCC ivdep
+			for(size_t j=0; j<tile; ++j)
+			{
+				c_row[j] = std::min(c_row[j], a_ik + b_row[j]);
+			}
+		}
+	}
+}
+
+template<class Hop>
+struct HopTiles
+{	// tiles of next hops and lengths at the tiles c, a and b of the distances, rows have the same stride as the distances
+	Hop* next_c;
+	const Hop* next_a;
+	Hop* length_c;
+	const Hop* length_a;
+	const Hop* length_b;
+};
+
+template<size_t tile, class Hop>
+void relax_tile_with_next(double* c, const double* a, const double* b, const HopTiles<Hop>& hops, const size_t stride)
+{	// relax_tile that also sets next(i, j) = next(i, k) when the path through k is shorter,
+	// or as short with fewer edges, each path then starts with the edge to its next hop and is not longer than a shortest
+	// path from there, and with the fewest edges as tie break, the next hop has a shortest path with one edge less,
+	// so following next hops ends at j even when blocked rounds relax through vertices of later k first
+	// lengths of the paths being compared are at most 2 x none, so they are added as size_t and capped at none
+	constexpr Hop none = std::numeric_limits<Hop>::max();
+	const double inf = std::numeric_limits<double>::infinity();
+	for(size_t k=0; k<tile; ++k)
+	{
+		const double* b_row = b + k * stride;
+		const Hop* length_b_row = hops.length_b + k * stride;
+		for(size_t i=0; i<tile; ++i)
+		{
+			double* c_row = c + i * stride;
+			Hop* next_c_row = hops.next_c + i * stride;
+			Hop* length_c_row = hops.length_c + i * stride;
+			const double a_ik = a[i * stride + k];
+			const Hop next_ik = hops.next_a[i * stride + k];
+			const size_t length_ik = hops.length_a[i * stride + k];
+			for(size_t j=0; j<tile; ++j)
+			{
+				const double via = a_ik + b_row[j];
+				const size_t length = std::min<size_t>(length_ik + length_b_row[j], none);
+				if(via < c_row[j] || (via == c_row[j] && via != inf && length < length_c_row[j]))
+				{
+					c_row[j] = via;
+					next_c_row[j] = next_ik;
+					length_c_row[j] = static_cast<Hop>(length);
+				}
+			}
+		}
+	}
+}
+
+bool negative_diagonal(const double* c, const size_t stride, const size_t tile)
+{	// whether a diagonal tile has a negative element on its diagonal
+	for(size_t i=0; i<tile; ++i)
+	{
+		if(c[i * stride + i] < 0)		return true;
+	}
+	return false;
+}
+
+using RelaxTile = void (*)(double*, const double*, const double*, size_t);
+
+RelaxTile relax_tile_of_size(const size_t tile)
+{	// instance of relax_tile for a supported tile size, nullptr for others
+	switch(tile)
+	{
+		case 16:	return relax_tile<16>;
+		case 32:	return relax_tile<32>;
+		case 64:	return relax_tile<64>;
+		case 128:	return relax_tile<128>;
+		case 256:	return relax_tile<256>;
+		default:	return nullptr;
+	}
+}
+
+class Barrier
+{	// threads calling wait are blocked until all of them have called it, then it can be used again
+	public:
+	explicit Barrier(const size_t _count)	:	count{_count}	{}
+	void wait()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		const size_t arrival_generation = generation;
+		if(++arrived == count)
+		{
+			arrived = 0;
+			++generation;
+			condition.notify_all();
+			return;
+		}
+		condition.wait(lock, [&]()
+		{
+			return generation != arrival_generation;
+		});
+	}
+	private:
+	std::mutex mutex;
+	std::condition_variable condition;
+	size_t count;
+	size_t arrived = 0;
+	size_t generation = 0;
 };
 
-long long floyd_warshall(const long long V, const std::vector<Edge>& edges)
-{	// returns "the shortest shortest path"
+template<class Hop>
+using RelaxTileWithNext = void (*)(double*, const double*, const double*, const HopTiles<Hop>&, size_t);
+
+template<class Hop>
+RelaxTileWithNext<Hop> relax_tile_with_next_of_size(const size_t tile)
+{	// instance of relax_tile_with_next for a supported tile size, nullptr for others
+	switch(tile)
+	{
+		case 16:	return relax_tile_with_next<16, Hop>;
+		case 32:	return relax_tile_with_next<32, Hop>;
+		case 64:	return relax_tile_with_next<64, Hop>;
+		case 128:	return relax_tile_with_next<128, Hop>;
+		case 256:	return relax_tile_with_next<256, Hop>;
+		default:	return nullptr;
+	}
+}
+
+// 64 x 64 doubles take 32 KB, so the three tiles of a step fit into a 256 KB L2 cache
+constexpr size_t default_tile = 64;
+
+// vertices of the next hops built by main
+constexpr size_t max_vertices = 65534;
+
+template<size_t MaxV = max_vertices>
+long long floyd_warshall(const long long V, const std::vector<Edge>& edges, const size_t tile = default_tile, const size_t threads = 1,
+						NextHops<MaxV>* next = nullptr)
+{	// returns "the shortest shortest path", or 0 when there is a negative cycle
+	// when next is given, it is filled with the next hops of shortest paths, which are meaningless after a negative cycle
 	// it runs in O(n^3) time
-	// construct base case
-	const long long E = edges.size();
+	// a single matrix is updated in place: in step k, row k and column k do not change, since A(k, k) >= 0 
+	// unless there is a negative cycle, so the other entries may read them before or after they are updated
+	// blocked algorithm: for each diagonal tile K, first the tile K is relaxed through itself,
+	// then the tiles in row K and column K through it, and finally all other tiles through those,
+	// so each tile is loaded into cache once per phase instead of once per k
+	// tiles of the second phase only depend on tile K, and tiles of the third phase on the tiles of the second phase,
+	// so the tiles of a phase are relaxed in parallel: threads take every threads-th tile of it and meet at a barrier after it
+	// threads are started once and run all rounds, thread 0 relaxes the diagonal tile
+	// a negative cycle shows up as a negative element on the diagonal, which is only written in diagonal tiles,
+	// so each of them is checked after it is relaxed and all threads stop after the round in which one is found
+	const RelaxTile relax = relax_tile_of_size(tile);
+	const RelaxTileWithNext<typename NextHops<MaxV>::Hop> relax_with_next = relax_tile_with_next_of_size<typename NextHops<MaxV>::Hop>(tile);
+	assert(relax != nullptr && relax_with_next != nullptr && "tile has to be 16, 32, 64, 128 or 256");
 	const double inf = std::numeric_limits<double>::infinity();
 	// SquareMatrix class is used to decrease space requirements
 	// from O(V^3) to O(V^2)
-	SquareMatrix Aprev(V + 1, inf);
-	SquareMatrix A(V + 1);
+	SquareMatrix A(V + 1, inf, tile);
 	for(long long i=1; i<=V; ++i)
 	{	// when u = v
-		Aprev(i, i) = 0;
+		A(i, i) = 0;
 	}
-	for(long long i=0; i<E; ++i)
-	{	// when there is an edge between u and v
-		Edge edge = edges[i];
-		Aprev(edge.u, edge.v) = edge.w;
+	for(const auto& edge : edges)
+	{	// when there is an edge between u and v, the cheapest of parallel edges
+		A(edge.u, edge.v) = std::min(A(edge.u, edge.v), static_cast<double>(edge.w));
 	}
-	for(long long k=1; k<=V; ++k)
-	{	// fw loops
+	const size_t stride = A.stride();
+	if(next != nullptr)
+	{	// a path from i to j starts with the edge to j
+		next->reset(V, stride);
+		for(const auto& edge : edges)
+		{
+			(*next)(edge.u, edge.v) = edge.v;
+			next->length(edge.u, edge.v) = 1;
+		}
 		for(long long i=1; i<=V; ++i)
 		{
-			for(long long j=1; j<=V; ++j)
-			{	
-				A(i, j) = std::min(Aprev(i, j), Aprev(i, k) + Aprev(k, j));
-			}
+			(*next)(i, i) = i;
+			next->length(i, i) = 0;
 		}
-		SquareMatrix::swap(Aprev, A);
 	}
-	// due to unnecessary swap at the end of outer loop, swap again
-	SquareMatrix::swap(Aprev, A);
-	for(long long i=1; i<=V; ++i)
-	{	// checks for negative edge cycles
-		if(A(i, i) < 0)
+	const size_t tiles = stride / tile;
+	const size_t thread_count = std::max<size_t>(threads, 1);
+	auto offset = [stride, tile](const size_t I, const size_t J)
+	{	// index of the first element of tile (I, J)
+		return I * tile * stride + J * tile;
+	};
+	// round in which a negative cycle was found, only ever set to the current round, so a thread
+	// that reads it after the end of round K while others are in round K + 1 sees K + 1 at most and goes on as they do
+	std::atomic<size_t> negative_round{tiles};
+	auto step = [&](const size_t I, const size_t J, const size_t K)
+	{	// relaxes tile (I, J) through tiles (I, K) and (K, J)
+		double* c = A.data() + offset(I, J);
+		if(next == nullptr)		relax(c, A.data() + offset(I, K), A.data() + offset(K, J), stride);
+		else
 		{
-			return 0;
+			const HopTiles<typename NextHops<MaxV>::Hop> hops{next->data() + offset(I, J), next->data() + offset(I, K), 
+				next->length_data() + offset(I, J), next->length_data() + offset(I, K), next->length_data() + offset(K, J)};
+			relax_with_next(c, A.data() + offset(I, K), A.data() + offset(K, J), hops, stride);
+		}
+		if(I == J && negative_diagonal(c, stride, tile))		negative_round.store(K, std::memory_order_relaxed);
+	};
+	Barrier barrier(thread_count);
+	auto work = [&](const size_t thread)
+	{
+		for(size_t K=0; K<tiles; ++K)
+		{	// fw loops over tiles
+			if(thread == 0)		step(K, K, K);
+			barrier.wait();
+			for(size_t J=thread; J<tiles; J+=thread_count)
+			{	// row K and column K
+				if(J == K)		continue;
+				step(K, J, K);
+				step(J, K, K);
+			}
+			barrier.wait();
+			for(size_t IJ=thread; IJ<tiles * tiles; IJ+=thread_count)
+			{	// remaining tiles, numbered row by row
+				const size_t I = IJ / tiles, J = IJ % tiles;
+				if(I != K && J != K)		step(I, J, K);
+			}
+			barrier.wait();
+			if(negative_round.load(std::memory_order_relaxed) <= K)		break;
 		}
+	};
+	std::vector<std::thread> workers;
+	for(size_t thread=1; thread<thread_count; ++thread)		workers.emplace_back(work, thread);
+	work(0);
+	for(auto& worker : workers)		worker.join();
+	if(negative_round.load() != tiles)
+	{	// negative edge cycle
+		if(next != nullptr)		next->set_negative_cycle();
+		return 0;
 	}
 	return static_cast<long long>(A.min_nondiagonal());
 }
 
-int main()
-{
-	auto start = std::chrono::high_resolution_clock::now();
-	std::ifstream file("g3.txt");
+size_t check_paths(const size_t graphs)
+{	// returns the number of random graphs for which some path does not match the distances of plain fw
+	// reduced weights are between 0 and 2 on top of random potentials, so there are negative edges and many zero weight cycles
+	// but no negative cycle, paths are checked for every tile size and 1 to 3 threads
+	std::mt19937 generator(42);
+	size_t failed = 0;
+	for(size_t graph=0; graph<graphs; ++graph)
+	{
+		const long long V = std::uniform_int_distribution<long long>(2, 150)(generator);
+		const long long E = std::uniform_int_distribution<long long>(V, 4 * V)(generator);
+		std::uniform_int_distribution<long long> vertex(1, V), potential(0, 20), reduced(0, 2);
+		std::vector<long long> p(V + 1);
+		for(auto& x : p)		x = potential(generator);
+		std::vector<Edge> edges(E);
+		for(auto& edge : edges)
+		{
+			edge.u = vertex(generator);
+			edge.v = vertex(generator);
+			edge.w = reduced(generator) + p[edge.u] - p[edge.v];
+		}
+		const double inf = std::numeric_limits<double>::infinity();
+		std::vector<std::vector<double>> weight(V + 1, std::vector<double>(V + 1, inf));
+		for(const auto& edge : edges)		weight[edge.u][edge.v] = std::min(weight[edge.u][edge.v], static_cast<double>(edge.w));
+		auto distance = weight;
+		for(long long i=1; i<=V; ++i)		distance[i][i] = 0;
+		for(long long k=1; k<=V; ++k)
+		{
+			for(long long i=1; i<=V; ++i)
+			{
+				for(long long j=1; j<=V; ++j)		distance[i][j] = std::min(distance[i][j], distance[i][k] + distance[k][j]);
+			}
+		}
+		bool correct = true;
+		for(const size_t tile : {16, 32, 64})
+		{
+			for(size_t threads=1; threads<=3; ++threads)
+			{
+				NextHops<max_vertices> next;
+				floyd_warshall(V, edges, tile, threads, &next);
+				for(long long u=1; u<=V; ++u)
+				{
+					for(long long v=1; v<=V; ++v)
+					{
+						const auto vertices = next.path(u, v);
+						double length = (vertices.empty() == true) ? inf : 0;
+						for(size_t i=1; i<vertices.size(); ++i)		length += weight[vertices[i - 1]][vertices[i]];
+						if(length != distance[u][v])		correct = false;
+					}
+				}
+			}
+		}
+		if(correct == false)		++failed;
+	}
+	return failed;
+}
+
+int main(int argc, char* argv[])
+{	// usage: floyd_warshall [FILE [THREADS [TILE [FROM TO]]]] | --check [GRAPHS]
+	// with more than one thread, the run is repeated on a single thread to report the speedup
+	// with FROM and TO, next hops are built too and a shortest path from FROM to TO is printed, unless there is a negative cycle
+	// FROM and TO are between 1 and V, and next hops are built for at most max_vertices vertices
+	// --check compares paths with plain fw on random graphs with zero weight cycles
+	if(argc > 1 && std::string(argv[1]) == "--check")
+	{
+		const size_t graphs = (argc > 2) ? std::stoul(argv[2]) : 100;
+		const size_t failed = check_paths(graphs);
+		std::cout << failed << " of " << graphs << " graphs have wrong paths\n";
+		return (failed == 0) ? 0 : 1;
+	}
+	const std::string path = (argc > 1) ? argv[1] : "g3.txt";
+	const size_t threads = (argc > 2) ? std::stoul(argv[2]) : 1;
+	const size_t tile = (argc > 3) ? std::stoul(argv[3]) : default_tile;
+	if(relax_tile_of_size(tile) == nullptr)
+	{	// only these sizes are instantiated, so that the inner loops of a tile are vectorized
+		std::cerr << "TILE should be 16, 32, 64, 128 or 256\n";
+		return 1;
+	}
+	std::ifstream file(path);
 	long long V, E;
 	file >> V >> E;
 	std::vector<Edge> edges(E);
@@ -131,9 +481,46 @@ int main()
 		edges[i] = edge;
 	}
 	file.close();
-	std::cout << floyd_warshall(V, edges) << "\n";
+	NextHops<max_vertices> next;
+	const bool paths = argc > 5;
+	const long long from = paths ? std::stoll(argv[4]) : 0, to = paths ? std::stoll(argv[5]) : 0;
+	if(paths && V > static_cast<long long>(max_vertices))
+	{
+		std::cerr << "Cannot build next hops for more than " << max_vertices << " vertices\n";
+		return 1;
+	}
+	if(paths && (from < 1 || from > V || to < 1 || to > V))
+	{
+		std::cerr << "FROM and TO should be between 1 and " << V << "\n";
+		return 1;
+	}
+	auto start = std::chrono::high_resolution_clock::now();
+	std::cout << floyd_warshall(V, edges, tile, threads, paths ? &next : nullptr) << "\n";
 	auto stop = std::chrono::high_resolution_clock::now();
-	auto duration = std::chrono::duration_cast<std::chrono::seconds>(stop - start);
-	std::cout << "Computed in " << duration.count() << " seconds\n";
+	auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+	std::cout << "Computed in " << duration.count() << " milliseconds using " << threads << " threads and " << tile << " x " << tile << " tiles\n";
+	if(threads > 1)
+	{
+		start = std::chrono::high_resolution_clock::now();
+		floyd_warshall(V, edges, tile, 1);
+		stop = std::chrono::high_resolution_clock::now();
+		auto single_duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+		std::cout << "Computed in " << single_duration.count() << " milliseconds using 1 thread, speedup " 
+				  << static_cast<double>(single_duration.count()) / std::max<double>(static_cast<double>(duration.count()), 1) << "\n";
+	}
+	if(paths)
+	{
+		if(next.negative_cycle() == true)
+		{
+			std::cout << "No paths, there is a negative cycle\n";
+		}
+		else
+		{
+			std::cout << "Path from " << from << " to " << to << ":";
+			for(const auto vertex : next.path(from, to))		std::cout << " " << vertex;
+			std::cout << "\n";
+		}
+		std::cout << "Next hops take " << next.bytes() / 1024 << " KB\n";
+	}
 	return 0;
 }
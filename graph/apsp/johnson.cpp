@@ -3,16 +3,15 @@
 #include <limits>
 #include <fstream>
 #include <queue>
+#include <algorithm>
+#include <string>
+#include <chrono>
+#include <type_traits>
 
-struct Edge
-{
-	std::size_t head;
-	long long weight;
-	bool operator()(const Edge& lhs, const Edge& rhs)
-	{	// this function is intended for min-heap data structure
-		return lhs.weight > rhs.weight;
-	}
-};
+#include "../sssp/queues.hpp"
+
+// edges and queue entries are (vertex, weight) pairs, queue policies are shared with dijkstra.cpp
+using Edge = BasicEdge<std::size_t, long long>;
 
 struct SingleSourceShortestPaths : std::pair<bool, std::vector<double>>
 {
@@ -77,75 +76,103 @@ class Graph
 		adj_list[u].push_back({v, w});
 	}
 	SingleSourceShortestPaths bellman_ford(std::size_t s) const;
-	SingleSourceShortestPaths::vector_type dijkstra(std::size_t s) const;
-	AllPairsShortestPaths johnson();
+	// Queue is one of BinaryHeap, RadixHeap, BucketQueue and IndexedHeap
+	template<template<class> class Queue = BinaryHeap> SingleSourceShortestPaths::vector_type dijkstra(std::size_t s) const;
+	template<template<class> class Queue = BinaryHeap> AllPairsShortestPaths johnson();
 	private:
 	std::vector<std::vector<Edge>> adj_list;
 	std::size_t V;
 };
 
 SingleSourceShortestPaths Graph::bellman_ford(std::size_t s) const
-{	// bellman-ford algorithm runs in O(nm) time 
+{	// queue-based bellman-ford with subtree disassembly (tarjan), O(nm) time in the worst case but close to O(m) on most graphs
 	// also works with negative weight edges
 	// due to artificial vertex added during construction, size of adj list is V + 1
+	// only vertices whose cost decreased are scanned, in first in first out order, and the search ends when the queue is empty
+	// the parents form a shortest path tree kept as a list in preorder, where the subtree of v follows v with larger depths
+	// when the cost of v decreases, its subtree is removed from the tree and not scanned until its costs decrease again;
+	// if the tail of the edge is in that subtree, the tree path from v to the tail and the edge close a negative cycle,
+	// which is reported as soon as it appears instead of after V rounds
 	const std::size_t V_plus_1 = adj_list.size();
+	constexpr std::size_t none = std::numeric_limits<std::size_t>::max();
 	std::vector<double> C(V_plus_1, std::numeric_limits<double>::infinity());
+	// parent is none for vertices outside the tree, next and previous link the tree in preorder starting from s
+	std::vector<std::size_t> parent(V_plus_1, none), next(V_plus_1, none), previous(V_plus_1, none), depth(V_plus_1, 0);
+	std::vector<bool> queued(V_plus_1, false);
+	std::queue<std::size_t> q;
 	C[s] = 0;
-	// compute cost from s to any node at most V' - 1 edges
-	for(std::size_t i=1; i<V_plus_1; ++i)
-	{	// edge count that might be used in any s - tail path
-		for(std::size_t tail=0; tail<V_plus_1; ++tail)
-		{	// this and inner loop below runs in O(m) combined, traversing all edges 
-			for(auto& edge : adj_list[tail])
-			{	// visit every edge from tail
-				C[edge.head] = std::min(C[edge.head], C[tail] + edge.weight);
-			}			
-		}
-	}
-	// check whether there is a negative weight cycle
-	// run inner loops one more time to see if we get a better path
-	// if so, then there is a negative weight cycle because any path cannot exceed |V - 1| edges without cycles
-	for(std::size_t tail=0; tail<V_plus_1; ++tail)
+	next[s] = previous[s] = parent[s] = s;
+	q.push(s);
+	queued[s] = true;
+	while(q.empty() == false)
 	{
-		for(auto& edge : adj_list[tail])
-		{
-			if(C[edge.head] > C[tail] + edge.weight)
+		const std::size_t tail = q.front();
+		q.pop();
+		queued[tail] = false;
+		// a vertex removed from the tree after it was queued waits for its cost to decrease again
+		if(parent[tail] == none)		continue;
+		for(const auto& edge : adj_list[tail])
+		{	// visit every edge from tail
+			const std::size_t v = edge.v;
+			if(C[tail] + edge.w >= C[v])		continue;
+			C[v] = C[tail] + edge.w;
+			if(parent[v] != none)
+			{	// the subtree of v follows v in preorder up to the first vertex which is not deeper than v
+				std::size_t last = next[v];
+				bool is_cycle = (v == tail);
+				for(; last != v && depth[last] > depth[v]; last = next[last])		is_cycle = is_cycle || (last == tail);
+				// tail is v or one of its descendants, so v -> ... -> tail -> v is a negative cycle
+				if(is_cycle == true)		return {true, C};
+				// remove the subtree, including v, from the preorder list
+				for(std::size_t w = next[v]; w != last; w = next[w])		parent[w] = none;
+				next[previous[v]] = last;
+				previous[last] = previous[v];
+			}
+			// v becomes the first child of tail
+			parent[v] = tail;
+			depth[v] = depth[tail] + 1;
+			next[v] = next[tail];
+			previous[next[tail]] = v;
+			next[tail] = v;
+			previous[v] = tail;
+			if(queued[v] == false)
 			{
-				return {true, C};
+				queued[v] = true;
+				q.push(v);
 			}
 		}
 	}
 	return {false, C};
 }
 
-SingleSourceShortestPaths::vector_type Graph::dijkstra(std::size_t s) const
-{	// runs in O(m lgn) time due to min heap data structure
-	std::priority_queue<Edge, std::vector<Edge>, Edge> q;
+template<template<class> class Queue> SingleSourceShortestPaths::vector_type Graph::dijkstra(std::size_t s) const
+{	// runs in O(m lgn) time with BinaryHeap and IndexedHeap, O(m + n lgC) with RadixHeap and O(m + nC) with BucketQueue
+	// where C is the largest weight
+	Queue<Edge> q(adj_list);
 	double inf = std::numeric_limits<double>::infinity();
 	// artifical vertex added during construction is not used here
 	std::vector<double> cost(this->V, inf);
 	// initialize for starting vertex
-	q.push({s, 0});
+	q.push(s, 0);
 	cost[s] = 0;
 	while(q.empty() == false)
 	{
-		std::size_t curr = q.top().head;
-		q.pop();
+		std::size_t curr = q.pop().v;
 		const auto& neighbours = adj_list[curr];
 		for(const auto& neighbour : neighbours)
 		{
-			long long prospective_cost = cost[curr] + neighbour.weight;
-			if(prospective_cost < cost[neighbour.head])
+			long long prospective_cost = cost[curr] + neighbour.w;
+			if(prospective_cost < cost[neighbour.v])
 			{
-				cost[neighbour.head] = prospective_cost;
-				q.push({neighbour.head, prospective_cost});
+				cost[neighbour.v] = prospective_cost;
+				q.push(neighbour.v, prospective_cost);
 			}
 		}
 	}
 	return cost;
 }
 
-AllPairsShortestPaths Graph::johnson()
+template<template<class> class Queue> AllPairsShortestPaths Graph::johnson()
 {	// jonhson's algorithm runs in O(nm lgn) time 
 	// which is much better for sparse graphs than floyd-warshall running in O(n^3) 
 	// first step is handled in construction phase by creating an edge between s-v pairs with weight 0 running in O(n)
@@ -161,15 +188,17 @@ AllPairsShortestPaths Graph::johnson()
 	{
 		for(auto& edge : adj_list[tail])
 		{	// ce' = ce + pu - pv for an edge u -> v
-			edge.weight += (vertex_weight[tail] - vertex_weight[edge.head]);
+			edge.w += (vertex_weight[tail] - vertex_weight[edge.v]);
 		}
 	}
 	// forth step is running dijkstra's algorithm on each vertex except the artificial vertex V
 	// running in O(nm lgn) due to n calls to dijkstra's algorithm running in O(m lgn)
+	// a bucket queue takes as many buckets as the largest reweighted weight, so the binary heap runs instead when that is too large
+	const bool falls_back = std::is_same<Queue<Edge>, BucketQueue<Edge>>::value && BucketQueue<Edge>::fits(adj_list) == false;
 	AllPairsShortestPaths::nested_vector_type cost(this->V, AllPairsShortestPaths::vector_type());
 	for(std::size_t s=0; s<this->V; ++s)
 	{	
-		cost[s] = this->dijkstra(s);
+		cost[s] = (falls_back == true) ? this->dijkstra<BinaryHeap>(s) : this->dijkstra<Queue>(s);
 	}
 	// fifth step is correcting the adj list returning back to original weights running in O(m)
 	// sixth step is correcting the path lengths running in O(n^2)
@@ -179,7 +208,7 @@ AllPairsShortestPaths Graph::johnson()
 		for(auto& edge : adj_list[tail])
 		{	// fifth step running in O(m)
 			// ce' = ce + pu - pv for an edge u -> v
-			edge.weight += vertex_weight[edge.head] - vertex_weight[tail];
+			edge.w += vertex_weight[edge.v] - vertex_weight[tail];
 		}
 		for(std::size_t head=0; head<this->V; ++head)
 		{	// sixth step running in O(n^2)
@@ -201,10 +230,22 @@ void print(const std::vector<std::vector<double>>& matrix)
 	}	
 }
 
-int main()
-{
+template<template<class> class Queue> AllPairsShortestPaths benchmark(Graph& graph, const char* name)
+{	// runs johnson with the given queue and writes its time to std::cerr
+	auto start = std::chrono::high_resolution_clock::now();
+	auto result = graph.johnson<Queue>();
+	auto stop = std::chrono::high_resolution_clock::now();
+	std::cerr << name << ": " << std::chrono::duration<double, std::milli>(stop - start).count() << " milliseconds\n";
+	return result;
+}
+
+int main(int argc, char* argv[])
+{	// usage: johnson [FILE [QUEUE]]
+	// QUEUE is binary, radix, bucket or indexed, binary by default
+	// compare runs johnson with each queue, writes their times to std::cerr and checks that they agree
 	// file is 1-based
-	std::ifstream file("johnson_data5.txt");
+	std::ifstream file((argc > 1) ? argv[1] : "johnson_data5.txt");
+	const std::string queue = (argc > 2) ? argv[2] : "binary";
 	std::size_t V, E;
 	file >> V >> E;
 	Graph graph(V);
@@ -216,7 +257,27 @@ int main()
 		graph.add_edge(u - 1, v - 1, w);
 	}
 	file.close();
-	auto [has_negative_cycle, cost] = graph.johnson();
+	AllPairsShortestPaths result{false, AllPairsShortestPaths::nested_vector_type()};
+	if(queue == "compare")
+	{
+		result = benchmark<BinaryHeap>(graph, "binary heap");
+		if(benchmark<RadixHeap>(graph, "radix heap") != result || benchmark<BucketQueue>(graph, "bucket queue") != result || 
+		   benchmark<IndexedHeap>(graph, "indexed 4-ary heap") != result)
+		{
+			std::cerr << "queues disagree\n";
+			return 1;
+		}
+	}
+	else if(queue == "binary")		result = graph.johnson<BinaryHeap>();
+	else if(queue == "radix")		result = graph.johnson<RadixHeap>();
+	else if(queue == "bucket")		result = graph.johnson<BucketQueue>();
+	else if(queue == "indexed")		result = graph.johnson<IndexedHeap>();
+	else
+	{
+		std::cerr << "Unknown queue " << queue << ", it should be binary, radix, bucket, indexed or compare\n";
+		return 1;
+	}
+	auto& [has_negative_cycle, cost] = result;
 	std::cout << "has negative cycle? " << std::boolalpha << has_negative_cycle << "\n";
 	print(cost);
 	return 0;
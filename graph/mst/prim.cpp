@@ -2,7 +2,10 @@
 #include <fstream>
 #include <vector>
 #include <algorithm>
+#include <limits>
 #include <queue>
+#include <chrono>
+#include <string>
 
 struct Edge
 {	// v is the head of directed edge
@@ -14,11 +17,100 @@ struct Edge
 	}
 };
 
-long long prim(const std::vector<std::vector<Edge>>& adj_list)
-{	// prim's minimum spanning tree algorithm with O(m lgn) due to heap
+class IndexedHeap
+{	// 4-ary min heap in which each vertex has at most one entry, position[v] locates the entry of v
+	// pushing a vertex which is already in the heap decreases its key in place, so no stale entries are left behind
+	// a vertex leaves the heap once it joins the tree, so the heap holds at most V entries instead of an entry per edge
+	public:
+	explicit IndexedHeap(const std::size_t V)	:	position(V, npos)	{}
+	bool empty() const
+	{
+		return heap.empty();
+	}
+	void push(const std::size_t v, const long long key)
+	{	// inserts v or decreases its key, keys are never increased
+		if(position[v] == npos)
+		{
+			position[v] = heap.size();
+			heap.push_back({static_cast<long long>(v), key});
+		}
+		else
+		{
+			heap[position[v]].w = key;
+		}
+		sift_up(position[v]);
+	}
+	Edge pop()
+	{
+		const Edge top = heap.front();
+		position[top.v] = npos;
+		heap.front() = heap.back();
+		heap.pop_back();
+		if(heap.empty() == false)		sift_down(0);
+		return top;
+	}
+	private:
+	static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+	std::vector<Edge> heap;
+	std::vector<std::size_t> position;
+	void place(const std::size_t i, const Edge& entry)
+	{
+		heap[i] = entry;
+		position[entry.v] = i;
+	}
+	void sift_up(std::size_t i)
+	{	// parents greater than the entry move down one level, then the entry is placed into the hole
+		const Edge entry = heap[i];
+		while(i > 0)
+		{
+			const std::size_t parent = (i - 1) / 4;
+			if(heap[parent].w <= entry.w)		break;
+			place(i, heap[parent]);
+			i = parent;
+		}
+		place(i, entry);
+	}
+	void sift_down(std::size_t i)
+	{	// the smallest child moves up one level while it is smaller than the entry
+		const Edge entry = heap[i];
+		const std::size_t size = heap.size();
+		while(4 * i + 1 < size)
+		{
+			const std::size_t first = 4 * i + 1;
+			const std::size_t last = std::min(first + 4, size);
+			std::size_t smallest = first;
+			for(std::size_t child = first + 1; child < last; ++child)
+			{
+				if(heap[child].w < heap[smallest].w)		smallest = child;
+			}
+			if(heap[smallest].w >= entry.w)		break;
+			place(i, heap[smallest]);
+			i = smallest;
+		}
+		place(i, entry);
+	}
+};
+
+struct Counters
+{	// work done by a prim run
+	// stale entries are popped after their vertex joined the tree, the indexed heap leaves none
+	// pushes are the entries inserted into the heap or, with the indexed heap, also the keys decreased
+	std::size_t pops = 0;
+	std::size_t stale = 0;
+	std::size_t pushes = 0;
+	std::size_t relaxations = 0;
+};
+
+long long lazy_prim(const std::vector<std::vector<Edge>>& adj_list, Counters* counters = nullptr)
+{	// prim with a binary heap of edges, as it was before IndexedHeap, kept to count the work the indexed heap avoids
+	// every edge to a vertex outside the tree is pushed, so the heap holds up to an entry per edge 
+	// and entries of vertices which joined the tree meanwhile are popped as stale entries
+	Counters local_counters;
+	Counters& count = (counters == nullptr) ? local_counters : *counters;
 	std::priority_queue<Edge, std::vector<Edge>, Edge> q;
 	// push 0th vertex with 0 cost
 	q.push({0, 0});
+	++count.pushes;
 	std::size_t V = adj_list.size();
 	std::vector<bool> visited(V, false);
 	long long cost = 0;
@@ -26,16 +118,56 @@ long long prim(const std::vector<std::vector<Edge>>& adj_list)
 	{
 		Edge current = q.top();
 		q.pop();
-		if(visited[current.v] == false)
+		++count.pops;
+		if(visited[current.v] == true)
 		{
-			visited[current.v] = true;
-			cost += current.w;
-			for(auto& neighbour : adj_list[current.v])	
+			++count.stale;
+			continue;
+		}
+		visited[current.v] = true;
+		cost += current.w;
+		count.relaxations += adj_list[current.v].size();
+		for(auto& neighbour : adj_list[current.v])	
+		{
+			if(visited[neighbour.v] == false)	
+			{
+				q.push(neighbour);
+				++count.pushes;
+			}
+		}
+	}
+	return cost;
+}
+
+long long prim(const std::vector<std::vector<Edge>>& adj_list, Counters* counters = nullptr)
+{	// prim's minimum spanning tree algorithm with O(m lgn) due to heap
+	// key of a vertex outside the tree is the weight of its cheapest edge to the tree, it is decreased in place as the tree grows
+	// counters are optional and accumulate over calls
+	Counters local_counters;
+	Counters& count = (counters == nullptr) ? local_counters : *counters;
+	std::size_t V = adj_list.size();
+	IndexedHeap q(V);
+	std::vector<long long> key(V, std::numeric_limits<long long>::max());
+	// push 0th vertex with 0 cost
+	q.push(0, 0);
+	++count.pushes;
+	key[0] = 0;
+	std::vector<bool> visited(V, false);
+	long long cost = 0;
+	while(q.empty() == false)
+	{
+		Edge current = q.pop();
+		++count.pops;
+		visited[current.v] = true;
+		cost += current.w;
+		count.relaxations += adj_list[current.v].size();
+		for(auto& neighbour : adj_list[current.v])	
+		{
+			if(visited[neighbour.v] == false && neighbour.w < key[neighbour.v])	
 			{
-				if(visited[neighbour.v] == false)	
-				{
-					q.push(neighbour);
-				}
+				key[neighbour.v] = neighbour.w;
+				q.push(neighbour.v, neighbour.w);
+				++count.pushes;
 			}
 		}
 	}
@@ -43,9 +175,23 @@ long long prim(const std::vector<std::vector<Edge>>& adj_list)
 }
 
 
-int main()
-{
-	std::ifstream file("edges.txt");
+template<class Function> long long benchmark(Function&& mst, const std::vector<std::vector<Edge>>& adj_list, const char* name)
+{	// runs an mst function once and writes its time and work to std::cerr
+	Counters counters;
+	auto start = std::chrono::high_resolution_clock::now();
+	const long long cost = mst(adj_list, &counters);
+	auto stop = std::chrono::high_resolution_clock::now();
+	std::cerr << name << ": " << std::chrono::duration<double, std::milli>(stop - start).count() << " milliseconds, " 
+			  << counters.pops << " pops, " << counters.stale << " stale entries, " << counters.pushes << " pushes, " 
+			  << counters.relaxations << " relaxations\n";
+	return cost;
+}
+
+int main(int argc, char* argv[])
+{	// usage: prim [FILE [compare]]
+	// with compare, the lazy heap runs too and the work of both heaps is written to std::cerr
+	std::ifstream file((argc > 1) ? argv[1] : "edges.txt");
+	const bool compare = (argc > 2) && std::string(argv[2]) == "compare";
 	std::size_t V = 0, E = 0;
 	file >> V >> E;
 	std::vector<std::vector<Edge>> adj_list(V, std::vector<Edge>());
@@ -57,6 +203,15 @@ int main()
 		adj_list[v - 1].push_back({u - 1, w});
 	}
 	file.close();
+	if(compare == true)
+	{
+		const long long lazy_cost = benchmark(lazy_prim, adj_list, "lazy heap");
+		if(benchmark(prim, adj_list, "indexed heap") != lazy_cost)
+		{
+			std::cerr << "lazy and indexed heaps disagree\n";
+			return 1;
+		}
+	}
 	std::cout << prim(adj_list) << "\n";
 	return 0;
 }
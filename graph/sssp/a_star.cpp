@@ -1,19 +1,171 @@
 #include <iostream>
 #include <vector>
-#include <queue>
 #include <cmath>
 #include <limits>
 #include <algorithm>
+#include <ratio>
+#include <string>
+#include <utility>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <queue>
 
 struct Cartesian
-{
+{	// heuristics below are policies of Graph::a_star, each gives a lower bound on the cost from v to t
+	// they are computed in double, so squared differences of projected coordinates cannot overflow
+	// rounding down keeps a bound admissible, and consistent when the bound is consistent and weights are integers
 	long long x, y;
-	static long long euclidian(const Cartesian& lhs, const Cartesian& rhs)
+};
+
+struct Euclidean
+{	// for weights not less than the straight line length of edges
+	static long long estimate(const Cartesian& v, const Cartesian& t)
+	{	// squares of doubles reach 10^308, std::hypot would also avoid that but is several times slower
+		const double dx = static_cast<double>(v.x - t.x), dy = static_cast<double>(v.y - t.y);
+		return static_cast<long long>(std::sqrt(dx * dx + dy * dy));
+	}
+};
+
+struct Manhattan
+{	// for weights not less than the manhattan length of edges, such as grids with horizontal and vertical edges only
+	// it is never less than the euclidean distance, so it directs the search more but is not admissible for diagonal edges
+	static long long estimate(const Cartesian& v, const Cartesian& t)
+	{
+		return static_cast<long long>(std::fabs(static_cast<double>(v.x - t.x)) + std::fabs(static_cast<double>(v.y - t.y)));
+	}
+};
+
+struct GreatCircle
+{	// x and y are longitude and latitude in millionths of a degree, as in DIMACS road networks,
+	// and weights are metres not less than the great circle distance between the ends of edges
+	static long long estimate(const Cartesian& v, const Cartesian& t)
+	{	// haversine formula on a sphere whose radius is a little less than the smallest radius of curvature of the earth
+		constexpr double radius = 6335000.0;
+		constexpr double radians = 3.14159265358979323846 / 180.0 / 1e6;
+		const double phi_v = static_cast<double>(v.y) * radians, phi_t = static_cast<double>(t.y) * radians;
+		const double sin_phi = std::sin((phi_t - phi_v) / 2);
+		const double sin_lambda = std::sin(static_cast<double>(t.x - v.x) * radians / 2);
+		const double a = sin_phi * sin_phi + std::cos(phi_v) * std::cos(phi_t) * sin_lambda * sin_lambda;
+		return static_cast<long long>(std::floor(2 * radius * std::asin(std::min(1.0, std::sqrt(a)))));
+	}
+};
+
+template<class Metric, class Speed = std::ratio<1>> struct MaxSpeed
+{	// for travel time weights, Speed is the largest distance of Metric covered in one unit of time on any edge
+	// dividing a distance by the largest speed gives a lower bound on the travel time
+	static long long estimate(const Cartesian& v, const Cartesian& t)
+	{
+		return Metric::estimate(v, t) * Speed::den / Speed::num;
+	}
+};
+
+class KdTree
+{	// static 2-d tree over points, built once in O(n lgn) time, for snapping coordinates to the nearest vertices
+	// the tree is implicit: the node of range [begin, end) is its median at (begin + end) / 2, split by x at even depths and by y at odd ones,
+	// and its children are the ranges on its two sides, points are stored in that order so that the search reads them from one array
+	// a search visits the side of the query point first, and the other side only when the splitting line is closer than the best so far,
+	// so a query takes O(lgn) expected time on well spread points
+	// distances are euclidean over the coordinates, which is close enough for snapping with longitude and latitude as well
+	public:
+	static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+	KdTree() = default;
+	explicit KdTree(const std::vector<Cartesian>& points)	:	nodes(points.size())
+	{
+		for(std::size_t v = 0; v < points.size(); ++v)		nodes[v] = {points[v], v};
+		build(0, nodes.size(), 0);
+	}
+	// nearest point to p, npos when there are no points
+	std::size_t nearest(const Cartesian& p) const
+	{
+		const auto result = nearest(p, 1);
+		return result.empty() ? npos : result.front();
+	}
+	// k nearest points to p, from the nearest one
+	std::vector<std::size_t> nearest(const Cartesian& p, const std::size_t k) const
+	{
+		Candidates candidates;
+		if(k > 0)		search(p, k, 0, nodes.size(), 0, candidates);
+		std::vector<std::size_t> result(candidates.size());
+		for(auto it = result.rbegin(); it != result.rend(); ++it)
+		{
+			*it = candidates.top().second;
+			candidates.pop();
+		}
+		return result;
+	}
+	private:
+	struct Node
 	{
-		return std::sqrt((lhs.x - rhs.x) * (lhs.x - rhs.x) + (lhs.y - rhs.y) * (lhs.y - rhs.y)); 
+		Cartesian point;
+		std::size_t id;
+	};
+	// max heap of (squared distance, id), the farthest of the k best at the top
+	using Candidates = std::priority_queue<std::pair<double, std::size_t>>;
+	std::vector<Node> nodes;
+	static double coordinate(const Cartesian& p, const std::size_t depth)
+	{
+		return static_cast<double>((depth % 2 == 0) ? p.x : p.y);
+	}
+	void build(const std::size_t begin, const std::size_t end, const std::size_t depth)
+	{
+		if(end - begin <= 1)		return;
+		const std::size_t middle = (begin + end) / 2;
+		std::nth_element(nodes.begin() + begin, nodes.begin() + middle, nodes.begin() + end, [depth](const Node& lhs, const Node& rhs)
+		{
+			return coordinate(lhs.point, depth) < coordinate(rhs.point, depth);
+		});
+		build(begin, middle, depth + 1);
+		build(middle + 1, end, depth + 1);
+	}
+	void search(const Cartesian& p, const std::size_t k, const std::size_t begin, const std::size_t end, const std::size_t depth, Candidates& candidates) const
+	{
+		if(begin >= end)		return;
+		const std::size_t middle = (begin + end) / 2;
+		const Node& node = nodes[middle];
+		const double dx = static_cast<double>(node.point.x - p.x), dy = static_cast<double>(node.point.y - p.y);
+		const double distance = dx * dx + dy * dy;
+		if(candidates.size() < k)					candidates.push({distance, node.id});
+		else if(distance < candidates.top().first)
+		{
+			candidates.pop();
+			candidates.push({distance, node.id});
+		}
+		const double offset = coordinate(p, depth) - coordinate(node.point, depth);
+		const bool is_left = offset < 0;
+		search(p, k, is_left ? begin : middle + 1, is_left ? middle : end, depth + 1, candidates);
+		if(candidates.size() < k || offset * offset < candidates.top().first)
+		{
+			search(p, k, is_left ? middle + 1 : begin, is_left ? end : middle, depth + 1, candidates);
+		}
 	}
 };
 
+template<class Function> void parallel_for(const std::size_t threads, const std::size_t count, Function&& function)
+{	// calls function(thread, i) for each i in [0, count) on the given number of threads
+	// indices are handed out in small chunks so that a few long queries do not keep the other threads idle
+	if(threads <= 1 || count <= 1)
+	{
+		for(std::size_t i = 0; i < count; ++i)		function(0, i);
+		return;
+	}
+	constexpr std::size_t chunk = 16;
+	std::atomic<std::size_t> next{0};
+	std::vector<std::thread> workers;
+	for(std::size_t thread = 0; thread < std::min(threads, count); ++thread)
+	{
+		workers.emplace_back([&, thread]()
+		{
+			for(std::size_t begin = next.fetch_add(chunk); begin < count; begin = next.fetch_add(chunk))
+			{
+				const std::size_t end = std::min(begin + chunk, count);
+				for(std::size_t i = begin; i < end; ++i)		function(thread, i);
+			}
+		});
+	}
+	for(auto& worker : workers)		worker.join();
+}
+
 struct Edge
 {
 	std::size_t head;
@@ -27,7 +179,45 @@ struct Edge
 class Graph
 {
 	public:
-	Graph(const std::size_t V) : vertices(V), adj_list(V, std::vector<Edge>()), heuristic_cost(V), cost(V)	{}
+	static constexpr long long inf = std::numeric_limits<long long>::max();
+	class Workspace
+	{	// costs, heuristic costs and heap of a query, allocated once for the graph and reused by queries
+		// a query lists the vertices it reaches, and resets only those, so it runs in time of its search space
+		public:
+		explicit Workspace(const Graph& graph)	:	labels(graph.adj_list.size())	{}
+		private:
+		friend class Graph;
+		static constexpr long long unknown = -1;
+		struct Label
+		{	// kept together, so that relaxing an edge touches one cache line of the head
+			long long cost = inf;
+			// computed when the vertex is first reached
+			long long heuristic_cost = unknown;
+		};
+		std::vector<Label> labels;
+		std::vector<std::size_t> touched;
+		// heap ordered by Edge, kept as a vector so that its memory is reused
+		std::vector<Edge> heap;
+		void reset()
+		{
+			for(const auto v : touched)		labels[v] = Label();
+			touched.clear();
+			heap.clear();
+		}
+		void push(const std::size_t v, const long long key)
+		{
+			heap.push_back({v, key});
+			std::push_heap(heap.begin(), heap.end(), Edge());
+		}
+		Edge pop()
+		{
+			std::pop_heap(heap.begin(), heap.end(), Edge());
+			const Edge top = heap.back();
+			heap.pop_back();
+			return top;
+		}
+	};
+	Graph(const std::size_t V) : vertices(V), adj_list(V, std::vector<Edge>())	{}
 	void add_vertex(std::size_t v, long long x, long long y)
 	{
 		vertices[v] = {x, y};
@@ -36,53 +226,164 @@ class Graph
 	{
 		adj_list[tail].push_back({head, weight});
 	}
-	long long a_star(const std::size_t, const std::size_t) const;
+	template<class Heuristic = Euclidean> long long a_star(const std::size_t, const std::size_t, Workspace&) const;
+	template<class Heuristic = Euclidean> long long a_star(const std::size_t s, const std::size_t t) const
+	{	// single query, a Workspace should be kept for several queries
+		Workspace workspace(*this);
+		return a_star<Heuristic>(s, t, workspace);
+	}
+	// coordinates are snapped to vertices through an index built after all vertices are added, 
+	// without it, snap returns KdTree::npos and a_star with coordinates returns -1
+	void build_spatial_index()
+	{
+		index = KdTree(vertices);
+	}
+	std::size_t snap(const Cartesian& p) const
+	{
+		return index.nearest(p);
+	}
+	std::vector<std::size_t> snap(const Cartesian& p, const std::size_t k) const
+	{
+		return index.nearest(p, k);
+	}
+	template<class Heuristic = Euclidean> long long a_star(const Cartesian& from, const Cartesian& to, Workspace& workspace) const
+	{	// cost between the vertices nearest to the given coordinates
+		const std::size_t s = snap(from), t = snap(to);
+		if(s == KdTree::npos || t == KdTree::npos)		return -1;
+		return a_star<Heuristic>(s, t, workspace);
+	}
+	// a query only changes its workspace, so queries with different workspaces may run on the same graph at the same time
+	template<class Heuristic = Euclidean> 
+	std::vector<long long> a_star(const std::vector<std::pair<std::size_t, std::size_t>>&, std::vector<Workspace>&) const;
+	template<class Heuristic = Euclidean> 
+	std::vector<long long> a_star(const std::vector<std::pair<std::size_t, std::size_t>>& queries, const std::size_t threads) const
+	{	// single batch, workspaces should be kept for several batches
+		std::vector<Workspace> workspaces(std::max<std::size_t>(threads, 1), Workspace(*this));
+		return a_star<Heuristic>(queries, workspaces);
+	}
 	private:
 	std::vector<Cartesian> vertices;
 	std::vector<std::vector<Edge>> adj_list;
-	// the following included as member variables to decrease time when multiple queries demanded on the same graph
-	mutable std::vector<long long> heuristic_cost;
-	mutable std::vector<long long> cost;
+	KdTree index;
 };
 
 
-long long Graph::a_star(const std::size_t s, const std::size_t t) const
-{
-	const std::size_t V = adj_list.size();
-	for(std::size_t v = 0; v < V; ++v)
-	{	// compute euclidian distance from v to t
-		heuristic_cost[v] = Cartesian::euclidian(vertices[v], vertices[t]);
-	}
-	std::priority_queue<Edge, std::vector<Edge>, Edge> q;
-	long long inf = std::numeric_limits<long long>::max();
-	std::fill(cost.begin(), cost.end(), inf);
+template<class Heuristic> long long Graph::a_star(const std::size_t s, const std::size_t t, Workspace& workspace) const
+{	// heuristic is selected at compile time, so its estimate is inlined into the search
+	auto& labels = workspace.labels;
+	auto reach = [&](const std::size_t v, const long long c)
+	{	// first reach of v computes its heuristic cost, later ones only decrease its cost
+		auto& label = labels[v];
+		if(label.heuristic_cost == Workspace::unknown)
+		{
+			label.heuristic_cost = Heuristic::estimate(vertices[v], vertices[t]);
+			workspace.touched.push_back(v);
+		}
+		label.cost = c;
+		workspace.push(v, c + label.heuristic_cost);
+	};
+	workspace.reset();
 	// initialize for starting vertex
-	q.push({s, 0});
-	cost[s] = 0;
-	while(q.empty() == false)
+	reach(s, 0);
+	while(workspace.heap.empty() == false)
 	{
-		std::size_t curr = q.top().head;
-		q.pop();
+		const Edge top = workspace.pop();
+		const std::size_t curr = top.head;
+		// skip the entries pushed before the cost of the vertex was decreased
+		const long long curr_cost = labels[curr].cost;
+		if(top.weight > curr_cost + labels[curr].heuristic_cost)		continue;
 		// since this is a directed search algorithm and shortest path between
 		// s and t is required, no need to continue search after reaching t 
-		if(curr == t)				return cost[t];
+		if(curr == t)				return curr_cost;
 		const auto& neighbours = adj_list[curr];
 		for(const auto& neighbour : neighbours)
 		{
-			long long prospective_cost = cost[curr] + neighbour.weight;
-			if(prospective_cost < cost[neighbour.head])
+			long long prospective_cost = curr_cost + neighbour.weight;
+			if(prospective_cost < labels[neighbour.head].cost)
 			{	// add to queue with tentative = prospective + heuristic
 				// tentative cost is giving directions to search
-				q.push({neighbour.head, prospective_cost + heuristic_cost[neighbour.head]});
-				cost[neighbour.head] = prospective_cost;
+				reach(neighbour.head, prospective_cost);
 			}
 		}
 	}	// path does not exist
 	return -1;
 }
 
-int main()
-{
+template<class Heuristic> 
+std::vector<long long> Graph::a_star(const std::vector<std::pair<std::size_t, std::size_t>>& queries, std::vector<Workspace>& workspaces) const
+{	// answers (s, t) queries on as many threads as workspaces, each thread searching with its own workspace
+	// costs are returned in the order of queries, -1 for a query with an end which snap could not find
+	std::vector<long long> costs(queries.size());
+	parallel_for(workspaces.size(), queries.size(), [&](std::size_t thread, std::size_t q)
+	{
+		const auto [s, t] = queries[q];
+		costs[q] = (s == KdTree::npos || t == KdTree::npos) ? -1 : a_star<Heuristic>(s, t, workspaces[thread]);
+	});
+	return costs;
+}
+
+template<class Heuristic> bool answer_queries_in_batch(const Graph& graph, const std::size_t threads, const bool coordinates)
+{	// reads all queries, answers them on 1, 2, ..., threads threads and writes the costs in input order
+	// a query is either two vertices or, with coordinates, the x and y of both ends which are snapped to their nearest vertices
+	// throughput and speedup over a single thread are written to std::cerr for each thread count,
+	// costs of every thread count are checked against those of a single thread, returns whether all of them agree
+	std::size_t Q;
+	std::cin >> Q;
+	std::vector<std::pair<std::size_t, std::size_t>> queries(Q);
+	std::vector<std::pair<Cartesian, Cartesian>> points(coordinates ? Q : 0);
+	for(std::size_t q = 0; q < Q; ++q)
+	{
+		if(coordinates == true)
+		{
+			std::cin >> points[q].first.x >> points[q].first.y >> points[q].second.x >> points[q].second.y;
+			continue;
+		}
+		std::cin >> queries[q].first >> queries[q].second;
+		--queries[q].first;
+		--queries[q].second;
+	}
+	if(coordinates == true)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for(std::size_t q = 0; q < Q; ++q)		queries[q] = {graph.snap(points[q].first), graph.snap(points[q].second)};
+		auto stop = std::chrono::steady_clock::now();
+		std::cerr << "Snapped " << 2 * Q << " points in " << std::chrono::duration<double, std::milli>(stop - start).count() << " milliseconds\n";
+	}
+	std::vector<long long> costs;
+	double single_thread_seconds = 0;
+	bool agree = true;
+	for(std::size_t thread_count = 1; thread_count <= std::max<std::size_t>(threads, 1); ++thread_count)
+	{
+		std::vector<Graph::Workspace> workspaces(thread_count, Graph::Workspace(graph));
+		auto start = std::chrono::steady_clock::now();
+		const auto thread_costs = graph.a_star<Heuristic>(queries, workspaces);
+		auto stop = std::chrono::steady_clock::now();
+		const double seconds = std::chrono::duration<double>(stop - start).count();
+		if(thread_count == 1)
+		{
+			costs = thread_costs;
+			single_thread_seconds = seconds;
+		}
+		else if(thread_costs != costs)
+		{
+			std::cerr << "Costs computed using " << thread_count << " threads differ from those of a single thread\n";
+			agree = false;
+		}
+		std::cerr << "Answered " << Q << " queries in " << seconds * 1000 << " milliseconds using " << thread_count << " threads, "
+				  << static_cast<double>(Q) / std::max(seconds, 1e-9) << " queries per second, speedup " 
+				  << single_thread_seconds / std::max(seconds, 1e-9) << "\n";
+	}
+	for(const auto cost : costs)		std::cout << cost << "\n";
+	return agree;
+}
+
+int main(int argc, char* argv[])
+{	// usage: a_star [euclidean | manhattan | great-circle [THREADS [coordinates]]] < input
+	// queries are answered in a single batch on 1, 2, ..., THREADS threads, with coordinates they are given as x and y of both ends
+	// exits with 1 when the costs of several threads differ from those of a single thread
+	const std::string heuristic = (argc > 1) ? argv[1] : "euclidean";
+	const std::size_t threads = (argc > 2) ? std::stoul(argv[2]) : 1;
+	const bool coordinates = (argc > 3) && std::string(argv[3]) == "coordinates";
 	std::size_t V, E;
 	std::cin >> V >> E;
 	Graph graph(V);
@@ -99,13 +400,16 @@ int main()
 		std::cin >> tail >> head >> weight;
 		graph.add_edge(tail - 1, head - 1, weight);
 	}
-	std::size_t Q;
-	std::cin >> Q;
-	std::size_t s, t;
-	for(std::size_t q = 0; q < Q; ++q)
+	if(coordinates == true)
 	{
-		std::cin >> s >> t;
-		std::cout << graph.a_star(s - 1, t - 1) << "\n";
+		auto start = std::chrono::steady_clock::now();
+		graph.build_spatial_index();
+		auto stop = std::chrono::steady_clock::now();
+		std::cerr << "Built spatial index in " << std::chrono::duration<double, std::milli>(stop - start).count() << " milliseconds\n";
 	}
-	return 0;
+	bool agree = true;
+	if(heuristic == "manhattan")			agree = answer_queries_in_batch<Manhattan>(graph, threads, coordinates);
+	else if(heuristic == "great-circle")	agree = answer_queries_in_batch<GreatCircle>(graph, threads, coordinates);
+	else									agree = answer_queries_in_batch<Euclidean>(graph, threads, coordinates);
+	return (agree == true) ? 0 : 1;
 }
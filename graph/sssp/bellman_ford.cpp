@@ -4,17 +4,28 @@
 #include <fstream>
 #include <string>
 #include <sstream>
+#include <cstdint>
+#include <algorithm>
+#include <chrono>
+#include <atomic>
+#include <thread>
 
-struct Edge
-{
-	std::size_t head;
-	long long weight;
+template<class Vertex, class Weight> struct BasicEdge
+{	// weights may be negative, so Weight should be a signed type
+	Vertex head;
+	Weight weight;
 };
 
-struct SingleSourceShortestPaths : std::pair<bool, std::vector<double>>
+using Edge = BasicEdge<std::size_t, long long>;
+// half the size of Edge, for graphs with less than 2^32 vertices and 32-bit weights
+using CompactEdge = BasicEdge<std::uint32_t, std::int32_t>;
+
+template<class Distance = long long> struct SingleSourceShortestPaths : std::pair<bool, std::vector<Distance>>
 {	// stands for single-source shortest paths
-	using super_type = std::pair<bool, std::vector<double>>;
-	SingleSourceShortestPaths(bool _has_negative_cycle, const std::vector<double>& _cost)	:	super_type{_has_negative_cycle, _cost}	{}
+	// the largest Distance stands for infinity
+	using super_type = std::pair<bool, std::vector<Distance>>;
+	SingleSourceShortestPaths(bool _has_negative_cycle, const std::vector<Distance>& _cost, const std::vector<std::size_t>& _cycle = {})	
+		:	super_type{_has_negative_cycle, _cost}, cycle{_cycle}	{}
 	// in this simple case, instead of creating inline functions, 
 	// references to variables could be used as public member variables (bool& has_negative_cycle etc)
 	// however, in general this is a bad approach, since references cannot be changed after construction
@@ -26,53 +37,207 @@ struct SingleSourceShortestPaths : std::pair<bool, std::vector<double>>
 	{	
 		return this->first;		
 	}
-	std::vector<double>& cost()
+	std::vector<Distance>& cost()
 	{	
 		return this->second;
 	}
-	const std::vector<double>& cost() const
+	const std::vector<Distance>& cost() const
 	{	
 		return this->second;
 	}
+	// vertices of a negative cycle in order, the last one has an edge to the first one, empty when there is none
+	// costs are not shortest path costs when there is a negative cycle
+	const std::vector<std::size_t>& negative_cycle() const
+	{
+		return cycle;
+	}
+	private:
+	std::vector<std::size_t> cycle;
 };
 
-SingleSourceShortestPaths bellman_ford(const std::vector<std::vector<Edge>> adj_list, const std::size_t s)
-{	// bellman-ford algorithm runs in O(nm) time 
+template<class Distance> Distance saturating_add(const Distance cost, const long long weight)
+{	// cost + weight clamped into [lowest, inf - 1], so that costs never wrap around and never become infinity
+	// cost is finite, costs driven below lowest by a negative cycle stay at lowest
+	const Distance lowest = std::numeric_limits<Distance>::lowest();
+	const Distance inf = std::numeric_limits<Distance>::max();
+	if(weight >= 0)
+	{	// a negative cost plus any weight stays below inf, and inf - cost does not overflow otherwise
+		return (cost >= 0 && static_cast<unsigned long long>(weight) >= static_cast<unsigned long long>(inf - cost)) ? inf - 1 : cost + static_cast<Distance>(weight);
+	}
+	return (cost < lowest - weight) ? lowest : cost + static_cast<Distance>(weight);
+}
+
+template<class Distance = long long, class Vertex, class Weight> 
+SingleSourceShortestPaths<Distance> bellman_ford(const std::vector<std::vector<BasicEdge<Vertex, Weight>>>& adj_list, const std::size_t s)
+{	// queue-based bellman-ford with subtree disassembly (tarjan), O(nm) time in the worst case but close to O(m) on most graphs
 	// also works with negative weight edges
+	// only vertices whose cost decreased are scanned, in first in first out order, and the search ends when the queue is empty,
+	// so a round in which nothing changes is never run
+	// the parents form a shortest path tree kept as a list in preorder, where the subtree of v follows v with larger depths
+	// when the cost of v decreases, costs in its subtree are outdated, so the subtree is removed from the tree and its vertices are
+	// not scanned until their costs decrease again; if the tail of the edge is in that subtree, the tree path from v to the tail
+	// and the edge close a negative cycle, which is returned, so a cycle is found as soon as it appears in the tree
+	// edges leaving unreached vertices are not relaxed, since infinity plus a negative weight is still infinity
+	static_assert(std::numeric_limits<Distance>::is_signed == true && sizeof(Distance) >= sizeof(Weight), "Distance should hold any weight");
 	const std::size_t V = adj_list.size();
-	std::vector<double> C(V, std::numeric_limits<double>::infinity());
+	const Distance inf = std::numeric_limits<Distance>::max();
+	constexpr std::size_t none = std::numeric_limits<std::size_t>::max();
+	std::vector<Distance> C(V, inf);
+	// parent is none for vertices outside the tree, next and previous link the tree in preorder starting from s
+	std::vector<std::size_t> parent(V, none), next(V, none), previous(V, none), depth(V, 0);
+	std::vector<bool> queued(V, false);
+	std::vector<std::size_t> queue;
+	queue.reserve(V);
 	C[s] = 0;
-	// compute cost from s to any node at most V - 1 edges
-	for(std::size_t i=1; i<V; ++i)
-	{	// edge count that might be used in any s - tail path
-		for(std::size_t tail=0; tail<V; ++tail)
-		{	// this and inner loop below runs in O(m) combined, traversing all edges 
-			for(auto& edge : adj_list[tail])
-			{	// visit every edge from tail
-				C[edge.head] = std::min(C[edge.head], C[tail] + edge.weight);
-			}			
+	next[s] = previous[s] = s;
+	parent[s] = s;
+	queue.push_back(s);
+	queued[s] = true;
+	// queue[head, end) are the vertices to scan, the vector is compacted when half of it is consumed
+	for(std::size_t head = 0; head < queue.size(); ++head)
+	{
+		if(2 * head > V && head > 64)
+		{
+			queue.erase(queue.begin(), queue.begin() + static_cast<std::ptrdiff_t>(head));
+			head = 0;
 		}
+		const std::size_t tail = queue[head];
+		queued[tail] = false;
+		// a vertex removed from the tree after it was queued waits for its cost to decrease again
+		if(parent[tail] == none)		continue;
+		for(const auto& edge : adj_list[tail])
+		{	// visit every edge from tail
+			const Distance prospective_cost = saturating_add(C[tail], edge.weight);
+			const std::size_t v = edge.head;
+			if(prospective_cost >= C[v])		continue;
+			C[v] = prospective_cost;
+			if(parent[v] != none)
+			{	// the subtree of v follows v in preorder up to the first vertex which is not deeper than v
+				std::size_t last = next[v];
+				bool is_cycle = (v == tail);
+				for(; last != v && depth[last] > depth[v]; last = next[last])		is_cycle = is_cycle || (last == tail);
+				if(is_cycle == true)
+				{	// tail is v or one of its descendants, so v -> ... -> tail -> v is a negative cycle
+					std::vector<std::size_t> cycle;
+					for(std::size_t w = tail; w != v; w = parent[w])		cycle.push_back(w);
+					cycle.push_back(v);
+					std::reverse(cycle.begin(), cycle.end());
+					return {true, C, cycle};
+				}
+				// remove the subtree, including v, from the preorder list
+				for(std::size_t w = next[v]; w != last; w = next[w])		parent[w] = none;
+				next[previous[v]] = last;
+				previous[last] = previous[v];
+			}
+			// v becomes the first child of tail
+			parent[v] = tail;
+			depth[v] = depth[tail] + 1;
+			next[v] = next[tail];
+			previous[next[tail]] = v;
+			next[tail] = v;
+			previous[v] = tail;
+			if(queued[v] == false)
+			{
+				queued[v] = true;
+				queue.push_back(v);
+			}
+		}
+	}
+	return {false, C};
+}
+
+template<class Function> void parallel_for(const std::size_t threads, const std::size_t count, Function&& function)
+{	// calls function(thread, i) for each i in [0, count) on the given number of threads
+	// indices are handed out in chunks through an atomic counter, small ranges are run on the calling thread
+	constexpr std::size_t chunk = 64;
+	if(threads <= 1 || count <= chunk)
+	{
+		for(std::size_t i = 0; i < count; ++i)		function(0, i);
+		return;
 	}
-	// check whether there is a negative weight cycle
-	// run inner loops one more time to see if we get a better path
-	// if so, then there is a negative weight cycle because any path cannot exceed |V - 1| edges without cycles
-	for(std::size_t tail=0; tail<V; ++tail)
+	std::atomic<std::size_t> next{0};
+	std::vector<std::thread> workers;
+	for(std::size_t thread = 0; thread < threads; ++thread)
 	{
-		for(auto& edge : adj_list[tail])
+		workers.emplace_back([&, thread]()
 		{
-			if(C[edge.head] > C[tail] + edge.weight)
+			for(std::size_t begin = next.fetch_add(chunk); begin < count; begin = next.fetch_add(chunk))
 			{
-				return {true, C};
+				const std::size_t end = std::min(begin + chunk, count);
+				for(std::size_t i = begin; i < end; ++i)		function(thread, i);
 			}
+		});
+	}
+	for(auto& worker : workers)		worker.join();
+}
+
+template<class Distance = long long, class Vertex, class Weight> 
+SingleSourceShortestPaths<Distance> parallel_bellman_ford(const std::vector<std::vector<BasicEdge<Vertex, Weight>>>& adj_list, const std::size_t s, 
+														  const std::size_t threads)
+{	// bellman-ford in rounds, where round i relaxes the edges of the vertices whose cost decreased in round i - 1
+	// vertices of a round are relaxed in parallel and costs are decreased by atomic compare and swap, so a round may already
+	// use costs decreased in the same round, which only makes costs smaller sooner
+	// after round i every cost is at most the cheapest path with i edges, so without a negative cycle reachable from s 
+	// round V changes nothing, and a cost decreased in round V means there is a negative cycle
+	// (unless the cycle drove costs down to the lowest Distance before, where saturating_add keeps them)
+	// edges are copied into a flat array indexed by offsets (compressed sparse rows), so a round reads them sequentially
+	static_assert(std::numeric_limits<Distance>::is_signed == true && sizeof(Distance) >= sizeof(Weight), "Distance should hold any weight");
+	const std::size_t V = adj_list.size();
+	const Distance inf = std::numeric_limits<Distance>::max();
+	std::vector<std::size_t> offsets(V + 1, 0);
+	for(std::size_t v = 0; v < V; ++v)		offsets[v + 1] = offsets[v] + adj_list[v].size();
+	std::vector<BasicEdge<Vertex, Weight>> edges(offsets[V]);
+	for(std::size_t v = 0; v < V; ++v)		std::copy(adj_list[v].begin(), adj_list[v].end(), edges.begin() + static_cast<std::ptrdiff_t>(offsets[v]));
+	std::vector<std::atomic<Distance>> C(V);
+	for(auto& c : C)		c.store(inf, std::memory_order_relaxed);
+	C[s].store(0, std::memory_order_relaxed);
+	// round in which each vertex was last added to the next frontier, so that it is added once per round
+	std::vector<std::atomic<std::size_t>> added(V);
+	for(auto& round : added)		round.store(0, std::memory_order_relaxed);
+	const std::size_t thread_count = std::max<std::size_t>(threads, 1);
+	std::vector<std::vector<std::size_t>> next(thread_count);
+	std::vector<std::size_t> frontier(1, s);
+	std::size_t round = 1;
+	for(; frontier.empty() == false && round <= V; ++round)
+	{
+		parallel_for(thread_count, frontier.size(), [&](std::size_t thread, std::size_t i)
+		{
+			const std::size_t tail = frontier[i];
+			const Distance cost = C[tail].load(std::memory_order_relaxed);
+			for(std::size_t e = offsets[tail]; e < offsets[tail + 1]; ++e)
+			{
+				const Distance prospective_cost = saturating_add(cost, edges[e].weight);
+				auto& head_cost = C[edges[e].head];
+				Distance old = head_cost.load(std::memory_order_relaxed);
+				while(prospective_cost < old)
+				{	// a failed exchange reloads old, then the loop ends if another thread found a cheaper path
+					if(head_cost.compare_exchange_weak(old, prospective_cost, std::memory_order_relaxed))
+					{
+						if(added[edges[e].head].exchange(round, std::memory_order_relaxed) != round)		next[thread].push_back(edges[e].head);
+						break;
+					}
+				}
+			}
+		});
+		frontier.clear();
+		for(auto& vertices : next)
+		{
+			frontier.insert(frontier.end(), vertices.begin(), vertices.end());
+			vertices.clear();
 		}
 	}
-	return {false, C};
+	std::vector<Distance> result(V);
+	for(std::size_t v = 0; v < V; ++v)		result[v] = C[v].load(std::memory_order_relaxed);
+	// the frontier is not empty after round V only when a cost decreased in round V
+	return {frontier.empty() == false, result};
 }
 
-int main()
-{
+int main(int argc, char* argv[])
+{	// usage: bellman_ford [FILE [THREADS]]
+	// the parallel variant runs on THREADS threads and should agree with the queue-based one
 	// file is 1-based
-	std::ifstream file("dijkstraData.txt");		
+	std::ifstream file((argc > 1) ? argv[1] : "dijkstraData.txt");		
+	const std::size_t threads = (argc > 2) ? std::stoul(argv[2]) : 1;
 	std::size_t V;
 	file >> V;
 	std::vector<std::vector<Edge>> adj_list(V, std::vector<Edge>());
@@ -95,8 +260,30 @@ int main()
 	file.close();
 	// compute shortest path distance from s to t (0-based)
 	std::size_t s = 0, t = 6;					
-	// auto [has_negative_cycle, cost] = bellman_ford(adj_list, s);
-	// std::cout << cost[t] << "\n";
-	std::cout << bellman_ford(adj_list, s).cost()[t] << "\n";
+	// inf when there is no path
+	auto start = std::chrono::high_resolution_clock::now();
+	const auto result = bellman_ford(adj_list, s);
+	auto stop = std::chrono::high_resolution_clock::now();
+	std::cerr << "bellman-ford: " << std::chrono::duration<double, std::milli>(stop - start).count() << " milliseconds\n";
+	start = std::chrono::high_resolution_clock::now();
+	const auto parallel_result = parallel_bellman_ford(adj_list, s, threads);
+	stop = std::chrono::high_resolution_clock::now();
+	std::cerr << "parallel bellman-ford on " << threads << " threads: " << std::chrono::duration<double, std::milli>(stop - start).count() << " milliseconds\n";
+	if(parallel_result.has_negative_cycle() != result.has_negative_cycle() || 
+	   (result.has_negative_cycle() == false && parallel_result.cost() != result.cost()))
+	{
+		std::cerr << "bellman-ford variants disagree\n";
+		return 1;
+	}
+	if(result.has_negative_cycle() == true)
+	{	// 1-based like the file
+		std::cout << "negative cycle:";
+		for(const auto v : result.negative_cycle())		std::cout << " " << v + 1;
+		std::cout << "\n";
+		return 0;
+	}
+	const auto distance = result.cost()[t];
+	if(distance == std::numeric_limits<long long>::max())		std::cout << "inf\n";
+	else														std::cout << distance << "\n";
 	return 0;
 }
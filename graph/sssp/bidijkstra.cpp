@@ -1,117 +1,597 @@
 #include <iostream>
 #include <vector>
-#include <queue>
+#include <algorithm>
 #include <limits>
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <cstdint>
+#include <chrono>
 
-struct Edge
-{
-	std::size_t head;
-	long long weight;
-	bool operator()(const Edge& lhs, const Edge& rhs)
+template<class Vertex, class Weight> struct BasicEdge
+{	// heap entries are (vertex, cost) pairs of the same form
+	Vertex head;
+	Weight weight;
+	bool operator()(const BasicEdge& lhs, const BasicEdge& rhs)
 	{	// this function is intended for min-heap data structure
 		return lhs.weight > rhs.weight;
 	}
 };
 
-class Graph
-{	
+template<class Entry> class IndexedHeap
+{	// 4-ary min heap in which each vertex has at most one entry, position[v] locates the entry of v
+	// pushing a vertex which is already in the heap decreases its key in place, so no stale entries are left behind
+	// each search settles a vertex once, so its heap holds at most V entries
+	using vertex_type = decltype(Entry::head);
+	using key_type = decltype(Entry::weight);
+	public:
+	explicit IndexedHeap(const std::size_t V)	:	position(V, npos)	{}
+	bool empty() const
+	{
+		return heap.empty();
+	}
+	void push(const vertex_type v, const key_type key)
+	{	// inserts v or decreases its key, keys are never increased
+		if(position[v] == npos)
+		{
+			position[v] = static_cast<vertex_type>(heap.size());
+			heap.push_back({v, key});
+		}
+		else
+		{
+			heap[position[v]].weight = key;
+		}
+		sift_up(position[v]);
+	}
+	const Entry& top() const
+	{
+		return heap.front();
+	}
+	Entry pop()
+	{
+		const Entry top = heap.front();
+		position[top.head] = npos;
+		heap.front() = heap.back();
+		heap.pop_back();
+		if(heap.empty() == false)		sift_down(0);
+		return top;
+	}
+	void clear()
+	{	// only the vertices left in the heap have positions to reset
+		for(const auto& entry : heap)		position[entry.head] = npos;
+		heap.clear();
+	}
+	private:
+	// positions are bounded by the number of vertices, so they share the type of vertex ids
+	static constexpr vertex_type npos = std::numeric_limits<vertex_type>::max();
+	std::vector<Entry> heap;
+	std::vector<vertex_type> position;
+	void place(const std::size_t i, const Entry& entry)
+	{
+		heap[i] = entry;
+		position[entry.head] = static_cast<vertex_type>(i);
+	}
+	void sift_up(std::size_t i)
+	{	// parents greater than the entry move down one level, then the entry is placed into the hole
+		const Entry entry = heap[i];
+		while(i > 0)
+		{
+			const std::size_t parent = (i - 1) / 4;
+			if(heap[parent].weight <= entry.weight)		break;
+			place(i, heap[parent]);
+			i = parent;
+		}
+		place(i, entry);
+	}
+	void sift_down(std::size_t i)
+	{	// the smallest child moves up one level while it is smaller than the entry
+		const Entry entry = heap[i];
+		const std::size_t size = heap.size();
+		while(4 * i + 1 < size)
+		{
+			const std::size_t first = 4 * i + 1;
+			const std::size_t last = std::min(first + 4, size);
+			std::size_t smallest = first;
+			for(std::size_t child = first + 1; child < last; ++child)
+			{
+				if(heap[child].weight < heap[smallest].weight)		smallest = child;
+			}
+			if(heap[smallest].weight >= entry.weight)		break;
+			place(i, heap[smallest]);
+			i = smallest;
+		}
+		place(i, entry);
+	}
+};
+
+template<class Entry> class LazyHeap
+{	// binary heap without decrease-key: pushing a vertex again leaves its old entry behind, which is skipped as stale when popped
+	// it is the heap bidijkstra used before IndexedHeap, kept to count the stale entries and relaxations the indexed heap avoids
+	public:
+	explicit LazyHeap(const std::size_t)	{}
+	bool empty() const
+	{
+		return heap.empty();
+	}
+	void push(const decltype(Entry::head) v, const decltype(Entry::weight) key)
+	{
+		heap.push_back({v, key});
+		std::push_heap(heap.begin(), heap.end(), Entry());
+	}
+	const Entry& top() const
+	{
+		return heap.front();
+	}
+	Entry pop()
+	{
+		std::pop_heap(heap.begin(), heap.end(), Entry());
+		const Entry top = heap.back();
+		heap.pop_back();
+		return top;
+	}
+	void clear()
+	{
+		heap.clear();
+	}
+	private:
+	std::vector<Entry> heap;
+};
+
+struct Counters
+{	// work done by the searches of a workspace, accumulated over queries
+	// stale entries are popped after their vertex was settled with a smaller key, the indexed heap leaves none
+	// before stale entries were skipped, their edges were relaxed again, skipped_relaxations counts those edges
+	std::size_t pops = 0;
+	std::size_t stale = 0;
+	std::size_t relaxations = 0;
+	std::size_t skipped_relaxations = 0;
+};
+
+template<class Vertex = std::size_t, class Weight = long long, class Distance = long long, template<class> class Queue = IndexedHeap> class BasicGraph
+{	// Vertex and Weight set the size of edges, std::uint32_t for both halves the memory of adjacency lists and heaps
+	// Queue is IndexedHeap, or LazyHeap to measure the work of stale entries
+	// costs are integers of type Distance whose largest value stands for infinity
+	// a relaxation whose cost would not fit below infinity is skipped instead of wrapping around
+	static_assert(std::numeric_limits<Distance>::max() >= std::numeric_limits<Weight>::max(), "Distance should hold any weight");
 	public:
+	using Edge = BasicEdge<Vertex, Weight>;
 	using representation_type = std::vector<std::vector<Edge>>;
-	using priority_queue_type = std::priority_queue<Edge, std::vector<Edge>, Edge>;
-	Graph(std::size_t V) : adj_list(V, std::vector<Edge>{}), rev_adj_list(V, std::vector<Edge>{}) {}
-	void add_edge(std::size_t tail, std::size_t head, long long weight)
+	using priority_queue_type = Queue<BasicEdge<Vertex, Distance>>;
+	static constexpr Distance inf = std::numeric_limits<Distance>::max();
+	class Workspace
+	{	// costs and heaps of both searches, allocated once for the graph and reused by queries
+		// each search lists the vertices whose cost it set, so a query resets those instead of all V costs
+		public:
+		explicit Workspace(const BasicGraph& graph)	
+			:	forward(graph.adj_list.size()), backward(graph.adj_list.size()), potential(graph.adj_list.size(), no_potential)	{}
+		// vertices settled by both searches of the last query
+		std::size_t settled_count() const
+		{
+			return settled;
+		}
+		const Counters& counters() const
+		{
+			return count;
+		}
+		private:
+		friend class BasicGraph;
+		struct Search
+		{	// heap keys are costs for bidijkstra and costs adjusted by potentials for alt
+			explicit Search(const std::size_t V)	:	cost(V, inf), pq(V)	{}
+			std::vector<Distance> cost;
+			priority_queue_type pq;
+			std::vector<Vertex> touched;
+			void reset()
+			{
+				for(const auto v : touched)		cost[v] = inf;
+				touched.clear();
+				pq.clear();
+			}
+			void reach(const std::size_t v, const Distance c, const Distance key)
+			{
+				if(cost[v] == inf)		touched.push_back(static_cast<Vertex>(v));
+				cost[v] = c;
+				pq.push(static_cast<Vertex>(v), key);
+			}
+		};
+		static constexpr Distance no_potential = std::numeric_limits<Distance>::lowest();
+		Search forward;
+		Search backward;
+		// potentials of alt depend on s and t, so they are computed once per query for the vertices it reaches
+		std::vector<Distance> potential;
+		std::size_t settled = 0;
+		Counters count;
+		void reset()
+		{	// a vertex with a potential was reached by one of the searches, so it is in one of the touched lists
+			for(const auto v : forward.touched)		potential[v] = no_potential;
+			for(const auto v : backward.touched)	potential[v] = no_potential;
+			forward.reset();
+			backward.reset();
+			settled = 0;
+		}
+	};
+	BasicGraph(std::size_t V) : adj_list(V, std::vector<Edge>{}), rev_adj_list(V, std::vector<Edge>{}) {}
+	void add_edge(std::size_t tail, std::size_t head, Weight weight)
+	{
+		adj_list[tail].push_back({static_cast<Vertex>(head), weight});
+		rev_adj_list[head].push_back({static_cast<Vertex>(tail), weight});
+	}
+	Distance bidijkstra(const std::size_t, const std::size_t, Workspace&) const;
+	Distance bidijkstra(const std::size_t s, const std::size_t t) const
+	{	// single query, a Workspace should be kept for several queries
+		Workspace workspace(*this);
+		return bidijkstra(s, t, workspace);
+	}
+	// ALT: A* search with landmarks and the triangle inequality, alt gives the same costs as bidijkstra 
+	// and without landmarks it explores as much as bidijkstra does
+	void select_landmarks(const std::size_t);
+	bool save_landmarks(const std::string&) const;
+	bool load_landmarks(const std::string&);
+	std::size_t landmark_count() const
 	{
-		adj_list[tail].push_back({head, weight});
-		rev_adj_list[head].push_back({tail, weight});
+		return landmarks.size();
 	}
-	double bidijkstra(const std::size_t, const std::size_t) const;
+	Distance alt(const std::size_t, const std::size_t, Workspace&) const;
 	private:
 	// a disadvantage is using 2x space
 	// different from kosaraju algorithm bidirectional dijkstra can be called very frequently,
 	// that is why reverse adjacency list is a member variable instead of automatic variable in the function 
 	representation_type adj_list;
 	representation_type rev_adj_list;
-	void explore(const std::size_t, const std::vector<Edge>&, std::vector<double>&, priority_queue_type&) const;
-	double shortest_distance(const std::vector<bool>&, const std::vector<bool>&, const std::vector<double>&, const std::vector<double>&) const;
+	// distance tables take 32 bits per entry, unknown marks a landmark which does not reach the vertex or is not reached by it
+	// distances in the tables are less than unknown, select_landmarks keeps only the landmarks for which that holds
+	// they are stored vertex by vertex, so all landmark distances of a vertex are read from one or two cache lines
+	// from_landmark[v * k + i] is the cost of landmark i to v and to_landmark[v * k + i] the cost of v to landmark i
+	static constexpr std::uint32_t unknown = std::numeric_limits<std::uint32_t>::max();
+	std::vector<std::uint32_t> landmarks;
+	std::vector<std::uint32_t> from_landmark;
+	std::vector<std::uint32_t> to_landmark;
+	struct FileHeader
+	{	// a table is loaded only into a graph with the same number of vertices
+		static constexpr char expected_magic[8] = {'L', 'A', 'N', 'D', 'M', 'R', 'K', '\0'};
+		static constexpr std::uint32_t expected_version = 1;
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t landmark_count;
+		std::uint64_t V;
+	};
+	using Search = typename Workspace::Search;
+	template<class Key> void explore(const BasicEdge<Vertex, Distance>&, const representation_type&, Search&, const Search&, Distance&, Key&&, Workspace&) const;
+	std::vector<Distance> costs_from(const std::size_t, const representation_type&) const;
+	Distance potential(const std::size_t, const std::size_t, const std::size_t, Workspace&) const;
 };
 
-void Graph::explore(const std::size_t curr, const std::vector<Edge>& neighbours, std::vector<double>& cost, priority_queue_type& pq) const
-{	// explore neighbours of current 
-	for(const auto& neigbour : neighbours)
+using Graph = BasicGraph<>;
+using LazyGraph = BasicGraph<std::size_t, long long, long long, LazyHeap>;
+
+template<class Vertex, class Weight, class Distance, template<class> class Queue> template<class Key>
+void BasicGraph<Vertex, Weight, Distance, Queue>::explore(const BasicEdge<Vertex, Distance>& top, const representation_type& graph, Search& search, 
+														  const Search& other, Distance& best, Key&& key, Workspace& workspace) const
+{	// settles the vertex of the popped entry top and explores its neighbours, key(v, cost) gives the heap key of a neighbour
+	// a neighbour reached by the other search closes an s - t path, so the shortest of those is kept in best
+	// keys grow with costs, so an entry whose key is larger than the key of the current cost was pushed before a decrease and is stale
+	const std::size_t curr = top.head;
+	const Distance curr_cost = search.cost[curr];
+	++workspace.count.pops;
+	if(top.weight > key(curr, curr_cost))
+	{
+		++workspace.count.stale;
+		workspace.count.skipped_relaxations += graph[curr].size();
+		return;
+	}
+	++workspace.settled;
+	workspace.count.relaxations += graph[curr].size();
+	for(const auto& neigbour : graph[curr])
 	{	// compute cost to go from initial vertex to neighbour 
-		long long prospective_cost = cost[curr] + neigbour.weight;
-		if(prospective_cost < cost[neigbour.head])
+		if(static_cast<Distance>(neigbour.weight) >= inf - curr_cost)		continue;
+		const Distance prospective_cost = curr_cost + static_cast<Distance>(neigbour.weight);
+		if(prospective_cost < search.cost[neigbour.head])
 		{	// if found a better path
-			cost[neigbour.head] = prospective_cost;
-			pq.push({neigbour.head, prospective_cost});
+			search.reach(neigbour.head, prospective_cost, key(neigbour.head, prospective_cost));
+			const Distance other_cost = other.cost[neigbour.head];
+			if(other_cost != inf && other_cost < inf - prospective_cost)		best = std::min(best, prospective_cost + other_cost);
 		}
 	}
 }
 
-double Graph::shortest_distance(const std::vector<bool>& fwd_visited, const std::vector<bool>& bwd_visited, const std::vector<double>& fwd_cost, const std::vector<double>& bwd_cost) const
-{
-	const std::size_t V = adj_list.size();
-	double distance = std::numeric_limits<double>::infinity();
-	for(std::size_t v=0; v<V; ++v)
+template<class Vertex, class Weight, class Distance, template<class> class Queue> 
+Distance BasicGraph<Vertex, Weight, Distance, Queue>::bidijkstra(const std::size_t s, const std::size_t t, Workspace& workspace) const
+{	// solves shortest path of road networks between two nodes in half time of dijkstra's algorithm in O(m lgn)
+	// the search with the smaller top key takes the next step, until the two top keys add up to the best path found,
+	// since an s - t path not found yet would pass through a vertex settled by neither search and cost at least that much
+	// the vertex settled by both searches first need not lie on the shortest path, so that is not a stopping rule
+	// only vertices reached by the query are touched, so queries between close vertices run in sublinear time
+	auto& forward = workspace.forward;
+	auto& backward = workspace.backward;
+	auto key = [](std::size_t, const Distance c)
+	{
+		return c;
+	};
+	workspace.reset();
+	forward.reach(s, 0, 0);
+	backward.reach(t, 0, 0);
+	Distance best = (s == t) ? 0 : inf;
+	// a search whose queue is empty has settled every vertex it can reach, so a shorter path would have been found
+	while(forward.pq.empty() == false && backward.pq.empty() == false)
 	{
-		if((fwd_visited[v] == true) || (bwd_visited[v] == true))
+		const Distance fwd_top = forward.pq.top().weight;
+		const Distance bwd_top = backward.pq.top().weight;
+		if(fwd_top >= best || bwd_top >= best - fwd_top)		break;
+		if(fwd_top <= bwd_top)
+		{	// forward step
+			explore(forward.pq.pop(), adj_list, forward, backward, best, key, workspace);
+		}
+		else
+		{	// backward step
+			explore(backward.pq.pop(), rev_adj_list, backward, forward, best, key, workspace);
+		}
+	}	// best is still inf when there is no s - t path
+	return best;
+}
+
+template<class Vertex, class Weight, class Distance, template<class> class Queue> 
+std::vector<Distance> BasicGraph<Vertex, Weight, Distance, Queue>::costs_from(const std::size_t s, const representation_type& graph) const
+{	// plain dijkstra over adj_list or rev_adj_list, for the landmark tables
+	std::vector<Distance> cost(graph.size(), inf);
+	priority_queue_type pq(graph.size());
+	cost[s] = 0;
+	pq.push(static_cast<Vertex>(s), 0);
+	while(pq.empty() == false)
+	{
+		const auto curr = pq.pop().head;
+		for(const auto& neigbour : graph[curr])
 		{
-			distance = std::min(distance, fwd_cost[v] + bwd_cost[v]);
+			if(static_cast<Distance>(neigbour.weight) >= inf - cost[curr])		continue;
+			const Distance prospective_cost = cost[curr] + static_cast<Distance>(neigbour.weight);
+			if(prospective_cost < cost[neigbour.head])
+			{
+				cost[neigbour.head] = prospective_cost;
+				pq.push(neigbour.head, prospective_cost);
+			}
 		}
 	}
-	return distance;
+	return cost;
 }
 
-double Graph::bidijkstra(const std::size_t s, const std::size_t t) const
-{	// solves shortest path of road networks between two nodes in half time of dijkstra's algorithm in O(m lgn)
+template<class Vertex, class Weight, class Distance, template<class> class Queue> 
+void BasicGraph<Vertex, Weight, Distance, Queue>::select_landmarks(const std::size_t count)
+{	// farthest selection: each landmark is the vertex farthest from the landmarks selected so far, the first one is farthest from vertex 0
+	// vertices no landmark reaches are taken first, so that each part of a disconnected graph gets a landmark
+	// landmarks on the border of the graph give the tightest bounds for the paths heading towards them
+	// selection stops early when a landmark is more than 2^32 - 2 away from a vertex, as its table would not fit into 32 bits
 	const std::size_t V = adj_list.size();
-	double inf = std::numeric_limits<double>::infinity();
-	// create forward and backward visit logs
-	std::vector<bool> fwd_visited(V, false);
-	std::vector<bool> bwd_visited(V, false);
-	// create forward and backward cost vectors
-	std::vector<double> fwd_cost(V, inf);
-	std::vector<double> bwd_cost(V, inf);
-	fwd_cost[s] = 0.;
-	bwd_cost[t] = 0.;
-	// create forward and backward priority queues (min heap)
-	priority_queue_type fwd_pq;
-	priority_queue_type bwd_pq;
-	fwd_pq.push({s, 0});
-	bwd_pq.push({t, 0});
-	// find s - v and v - t shortest paths
-	while((fwd_pq.empty() == false) || (bwd_pq.empty() == false))
-	{	// iterate until both of the queues are empty
-		if(fwd_pq.empty() == false)
+	landmarks.clear();
+	if(V == 0)
+	{	// there is no vertex 0 to start from, nor any landmark to select
+		from_landmark.clear();
+		to_landmark.clear();
+		return;
+	}
+	std::vector<std::vector<std::uint32_t>> from_columns, to_columns;
+	std::vector<Distance> nearest = costs_from(0, adj_list);
+	auto compact = [](const std::vector<Distance>& cost, std::vector<std::uint32_t>& column)
+	{	// returns false when a cost does not fit
+		column.resize(cost.size());
+		for(std::size_t v = 0; v < cost.size(); ++v)
+		{
+			if(cost[v] != inf && cost[v] >= static_cast<Distance>(unknown))		return false;
+			column[v] = (cost[v] == inf) ? unknown : static_cast<std::uint32_t>(cost[v]);
+		}
+		return true;
+	};
+	while(landmarks.size() < std::min(count, V))
+	{
+		std::size_t farthest = 0;
+		for(std::size_t v = 1; v < V; ++v)
+		{
+			if(nearest[v] > nearest[farthest])		farthest = v;
+		}
+		if(nearest[farthest] == 0)		break;
+		const auto from = costs_from(farthest, adj_list);
+		const auto to = costs_from(farthest, rev_adj_list);
+		from_columns.emplace_back();
+		to_columns.emplace_back();
+		if(compact(from, from_columns.back()) == false || compact(to, to_columns.back()) == false)
+		{
+			from_columns.pop_back();
+			to_columns.pop_back();
+			break;
+		}
+		landmarks.push_back(static_cast<std::uint32_t>(farthest));
+		for(std::size_t v = 0; v < V; ++v)		nearest[v] = std::min(nearest[v], from[v]);
+	}
+	const std::size_t k = landmarks.size();
+	from_landmark.assign(V * k, unknown);
+	to_landmark.assign(V * k, unknown);
+	for(std::size_t v = 0; v < V; ++v)
+	{
+		for(std::size_t i = 0; i < k; ++i)
+		{
+			from_landmark[v * k + i] = from_columns[i][v];
+			to_landmark[v * k + i] = to_columns[i][v];
+		}
+	}
+}
+
+template<class Vertex, class Weight, class Distance, template<class> class Queue> 
+bool BasicGraph<Vertex, Weight, Distance, Queue>::save_landmarks(const std::string& path) const
+{	// header, landmark ids, then the two tables
+	FileHeader header{};
+	std::copy(std::begin(FileHeader::expected_magic), std::end(FileHeader::expected_magic), header.magic);
+	header.version = FileHeader::expected_version;
+	header.landmark_count = static_cast<std::uint32_t>(landmarks.size());
+	header.V = adj_list.size();
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	auto write = [&file](const void* data, const std::size_t size)
+	{
+		file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+	};
+	write(&header, sizeof(FileHeader));
+	write(landmarks.data(), landmarks.size() * sizeof(std::uint32_t));
+	write(from_landmark.data(), from_landmark.size() * sizeof(std::uint32_t));
+	write(to_landmark.data(), to_landmark.size() * sizeof(std::uint32_t));
+	return file.good();
+}
+
+template<class Vertex, class Weight, class Distance, template<class> class Queue> 
+bool BasicGraph<Vertex, Weight, Distance, Queue>::load_landmarks(const std::string& path)
+{	// the landmarks are left unchanged on failure
+	std::ifstream file(path, std::ios::binary);
+	FileHeader header;
+	if(file.read(reinterpret_cast<char*>(&header), sizeof(FileHeader)).good() == false)		return false;
+	if(std::equal(std::begin(header.magic), std::end(header.magic), FileHeader::expected_magic) == false)		return false;
+	if(header.version != FileHeader::expected_version || header.V != adj_list.size())		return false;
+	const std::size_t k = header.landmark_count;
+	std::vector<std::uint32_t> ids(k), from(k * adj_list.size()), to(k * adj_list.size());
+	auto read = [&file](std::vector<std::uint32_t>& data)
+	{
+		file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size() * sizeof(std::uint32_t)));
+	};
+	read(ids);
+	read(from);
+	read(to);
+	if(file.good() == false)		return false;
+	landmarks.swap(ids);
+	from_landmark.swap(from);
+	to_landmark.swap(to);
+	return true;
+}
+
+template<class Vertex, class Weight, class Distance, template<class> class Queue> 
+Distance BasicGraph<Vertex, Weight, Distance, Queue>::potential(const std::size_t v, const std::size_t s, const std::size_t t, Workspace& workspace) const
+{	// forward bound pf(v) <= cost(v, t) and backward bound pb(v) <= cost(s, v) come from the triangle inequality:
+	// cost(v, t) >= cost(v, L) - cost(t, L) and cost(v, t) >= cost(L, t) - cost(L, v) for each landmark L, similarly for cost(s, v)
+	// each bound is consistent, but the searches need potentials that add up to a constant, so both use (pf(v) - pb(v)) / 2
+	// that is returned doubled, to stay an integer, and it is cached for the query
+	// unknown is larger than any distance in the tables, so it acts as infinity and the bounds stay valid and consistent
+	Distance& result = workspace.potential[v];
+	if(result != Workspace::no_potential)		return result;
+	const std::size_t k = landmarks.size();
+	const std::uint32_t* from_v = from_landmark.data() + v * k;
+	const std::uint32_t* to_v = to_landmark.data() + v * k;
+	const std::uint32_t* from_s = from_landmark.data() + s * k;
+	const std::uint32_t* to_s = to_landmark.data() + s * k;
+	const std::uint32_t* from_t = from_landmark.data() + t * k;
+	const std::uint32_t* to_t = to_landmark.data() + t * k;
+	auto difference = [](const std::uint32_t lhs, const std::uint32_t rhs)
+	{
+		return static_cast<Distance>(lhs) - static_cast<Distance>(rhs);
+	};
+	Distance forward = 0, backward = 0;
+	for(std::size_t i = 0; i < k; ++i)
+	{
+		forward = std::max({forward, difference(to_v[i], to_t[i]), difference(from_t[i], from_v[i])});
+		backward = std::max({backward, difference(from_v[i], from_s[i]), difference(to_s[i], to_v[i])});
+	}
+	result = forward - backward;
+	return result;
+}
+
+template<class Vertex, class Weight, class Distance, template<class> class Queue> 
+Distance BasicGraph<Vertex, Weight, Distance, Queue>::alt(const std::size_t s, const std::size_t t, Workspace& workspace) const
+{	// bidirectional A*: the forward search orders vertices by cost(s, v) + p(v) and the backward search by cost(v, t) - p(v),
+	// keys are doubled like p, so a vertex on a shortest path has keys adding up to twice the path cost
+	// hence the searches stop when the two top keys add up to twice the best path found, as bidijkstra does with plain costs
+	// the bounds steer both searches towards each other, so they settle much fewer vertices than bidijkstra
+	// keys may be negative, so Distance should be signed, and costs should stay below a quarter of its largest value
+	static_assert(std::numeric_limits<Distance>::is_signed, "alt needs signed keys");
+	auto& forward = workspace.forward;
+	auto& backward = workspace.backward;
+	auto forward_key = [&](const std::size_t v, const Distance c)
+	{
+		return 2 * c + potential(v, s, t, workspace);
+	};
+	auto backward_key = [&](const std::size_t v, const Distance c)
+	{
+		return 2 * c - potential(v, s, t, workspace);
+	};
+	workspace.reset();
+	forward.reach(s, 0, forward_key(s, 0));
+	backward.reach(t, 0, backward_key(t, 0));
+	Distance best = (s == t) ? 0 : inf;
+	while(forward.pq.empty() == false && backward.pq.empty() == false)
+	{
+		const Distance fwd_top = forward.pq.top().weight;
+		const Distance bwd_top = backward.pq.top().weight;
+		if(best != inf && fwd_top + bwd_top >= 2 * best)		break;
+		if(fwd_top <= bwd_top)
 		{	// forward step
-			auto fwd = fwd_pq.top().head;
-			fwd_pq.pop();
-			explore(fwd, adj_list[fwd], fwd_cost, fwd_pq);
-			fwd_visited[fwd] = true;
-			if(bwd_visited[fwd] == true)					return shortest_distance(fwd_visited, bwd_visited, fwd_cost, bwd_cost);
+			explore(forward.pq.pop(), adj_list, forward, backward, best, forward_key, workspace);
 		}
-		if(bwd_pq.empty() == false)
+		else
 		{	// backward step
-			auto bwd = bwd_pq.top().head;
-			bwd_pq.pop();
-			explore(bwd, rev_adj_list[bwd], bwd_cost, bwd_pq);
-			bwd_visited[bwd] = true;
-			if(fwd_visited[bwd] == true)					return shortest_distance(fwd_visited, bwd_visited, fwd_cost, bwd_cost);
-		}
-	}	// when while loop is broken due to condition, there is no s - t path
-	return inf;
+			explore(backward.pq.pop(), rev_adj_list, backward, forward, best, backward_key, workspace);
+		}
+	}
+	return best;
+}
+
+void report_counters(const char* name, const Counters& counters, const std::size_t queries)
+{
+	std::cerr << name << ": " << counters.pops / queries << " pops, " << counters.stale / queries << " stale entries, " 
+			  << counters.relaxations / queries << " relaxations, " << counters.skipped_relaxations / queries 
+			  << " redundant relaxations skipped per query\n";
 }
 
-int main()
-{	
+bool benchmark(const Graph& graph, const LazyGraph& lazy_graph, const std::size_t V, const std::size_t queries)
+{	// pseudo-random queries answered by bidijkstra with the lazy and the indexed heap and by alt,
+	// average times, settled vertices and counters are written to std::cerr
+	// returns whether all of them give the same costs
+	Graph::Workspace workspace(graph);
+	std::vector<std::pair<std::size_t, std::size_t>> pairs(queries);
+	for(std::size_t i = 0; i < queries; ++i)		pairs[i] = {(i * 7919 + 13) % V, (i * 104729 + 71) % V};
+	std::vector<long long> expected(queries);
+	bool agree = true;
+	LazyGraph::Workspace lazy_workspace(lazy_graph);
+	std::size_t settled = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for(std::size_t i = 0; i < queries; ++i)
+	{
+		expected[i] = lazy_graph.bidijkstra(pairs[i].first, pairs[i].second, lazy_workspace);
+		settled += lazy_workspace.settled_count();
+	}
+	auto stop = std::chrono::high_resolution_clock::now();
+	std::cerr << "bidijkstra, lazy heap: " << std::chrono::duration<double, std::micro>(stop - start).count() / queries << " microseconds, " 
+			  << settled / queries << " settled vertices per query\n";
+	report_counters("bidijkstra, lazy heap", lazy_workspace.counters(), queries);
+	settled = 0;
+	start = std::chrono::high_resolution_clock::now();
+	for(std::size_t i = 0; i < queries; ++i)
+	{
+		agree = agree && graph.bidijkstra(pairs[i].first, pairs[i].second, workspace) == expected[i];
+		settled += workspace.settled_count();
+	}
+	stop = std::chrono::high_resolution_clock::now();
+	std::cerr << "bidijkstra: " << std::chrono::duration<double, std::micro>(stop - start).count() / queries << " microseconds, " 
+			  << settled / queries << " settled vertices per query\n";
+	report_counters("bidijkstra", workspace.counters(), queries);
+	settled = 0;
+	start = std::chrono::high_resolution_clock::now();
+	for(std::size_t i = 0; i < queries; ++i)
+	{
+		agree = agree && graph.alt(pairs[i].first, pairs[i].second, workspace) == expected[i];
+		settled += workspace.settled_count();
+	}
+	stop = std::chrono::high_resolution_clock::now();
+	std::cerr << "alt with " << graph.landmark_count() << " landmarks: " << std::chrono::duration<double, std::micro>(stop - start).count() / queries 
+			  << " microseconds, " << settled / queries << " settled vertices per query\n";
+	return agree;
+}
+
+int main(int argc, char* argv[])
+{	// usage: bidijkstra [FILE [QUERIES [LANDMARKS [TABLE]]]]
+	// with QUERIES > 0, LANDMARKS landmarks are loaded from TABLE, or selected and written to it when it cannot be loaded,
+	// then bidijkstra with the lazy and the indexed heap and alt are compared on QUERIES pseudo-random queries
 	// file is 1-based
-	std::ifstream file("dijkstraData.txt");							
+	std::ifstream file((argc > 1) ? argv[1] : "dijkstraData.txt");							
+	const std::size_t queries = (argc > 2) ? std::stoul(argv[2]) : 0;
+	const std::size_t landmark_count = (argc > 3) ? std::stoul(argv[3]) : 16;
+	const std::string table = (argc > 4) ? argv[4] : "";
 	std::size_t V;
 	file >> V;
 	Graph graph(V);
+	// the same graph searched with the lazy heap, filled only for the benchmark
+	LazyGraph lazy_graph(queries > 0 ? V : 0);
 	std::string line;
 	while(file.eof() == false)
 	{	// each row starts with the tail vertex
@@ -125,10 +605,31 @@ int main()
 		while(buffer >> v >> comma >> w)
 		{	// adj list is 0-based				
 			graph.add_edge(u - 1, v - 1, w);
+			if(queries > 0)		lazy_graph.add_edge(u - 1, v - 1, w);
 		}
 	}
 	file.close();
+	if(queries > 0)
+	{
+		if(table.empty() == true || graph.load_landmarks(table) == false)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			graph.select_landmarks(landmark_count);
+			auto stop = std::chrono::high_resolution_clock::now();
+			std::cerr << "selected " << graph.landmark_count() << " landmarks in " << std::chrono::duration<double, std::milli>(stop - start).count() << " milliseconds\n";
+			if(table.empty() == false && graph.save_landmarks(table) == false)		std::cerr << "cannot write " << table << "\n";
+		}
+		if(benchmark(graph, lazy_graph, V, queries) == false)
+		{
+			std::cerr << "alt and bidijkstra disagree\n";
+			return 1;
+		}
+	}
 	// compute shortest path distance from s to t (0-based)
+	// inf when there is no path
 	std::size_t s = 0, t = 6;
-	std::cout << graph.bidijkstra(s, t) << "\n";
+	Graph::Workspace workspace(graph);
+	const auto distance = graph.bidijkstra(s, t, workspace);
+	if(distance == Graph::inf)		std::cout << "inf\n";
+	else							std::cout << distance << "\n";
 }
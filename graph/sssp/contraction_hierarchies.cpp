@@ -9,92 +9,825 @@
 #include <vector>
 #include <queue>
 #include <limits>
-#include <cmath> 
 #include <algorithm>
 #include <chrono>
 #include <type_traits>
 #include <cassert>
+#include <numeric>
+#include <thread>
+#include <atomic>
+#include <string>
+#include <fstream>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <charconv>
+#include <iterator>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-// these two classes are created to increase readability and maintainability of Graph::shortcut function
+// these three classes are created to increase readability and maintainability of Graph::shortcut function
 struct CreateAndCountShortcuts {};
 struct OnlyCountShortcuts {};
+struct CollectShortcuts {};
 
 struct Edge
-{
+{	// middle is the contracted node bypassed by a shortcut, original edges have none
+	static constexpr std::size_t none = std::numeric_limits<std::size_t>::max();
 	std::size_t head;
 	long long weight;
+	std::size_t middle = none;
 	bool operator()(const Edge& lhs, const Edge& rhs)
 	{	// this overload is intended for min heap
 		return lhs.weight > rhs.weight;
 	}
 };
 
+struct Shortcut
+{	// shortcut found by a worker thread during parallel contraction
+	// it is added to the graph after all workers of the round are joined
+	std::size_t tail;
+	std::size_t head;
+	long long weight;
+	std::size_t middle;
+};
+
+template<class Function> void parallel_for(const std::size_t threads, const std::size_t count, Function&& function)
+{	// calls function(thread, i) for each i in [0, count) on the given number of threads
+	// indices are handed out in small chunks so that a few expensive nodes do not keep the other threads idle
+	if(threads <= 1 || count <= 1)
+	{
+		for(std::size_t i = 0; i < count; ++i)		function(0, i);
+		return;
+	}
+	constexpr std::size_t chunk = 16;
+	std::atomic<std::size_t> next{0};
+	std::vector<std::thread> workers;
+	for(std::size_t thread = 0; thread < std::min(threads, count); ++thread)
+	{
+		workers.emplace_back([&, thread]()
+		{
+			for(std::size_t begin = next.fetch_add(chunk); begin < count; begin = next.fetch_add(chunk))
+			{
+				const std::size_t end = std::min(begin + chunk, count);
+				for(std::size_t i = begin; i < end; ++i)		function(thread, i);
+			}
+		});
+	}
+	for(auto& worker : workers)		worker.join();
+}
+
+struct CompactEdge
+{	// edge of ContractedGraph, 32-bit head and weight take half the memory of Edge
+	std::uint32_t head;
+	std::uint32_t weight;
+};
+
+struct AdjacencyArray
+{	// flat adjacency list (CSR), edges of vertex v are edges[offsets[v]] ... edges[offsets[v + 1] - 1]
+	// middles[i] is the middle node of edges[i], it is kept apart so that searches do not load it
+	// it does not own its arrays, they belong to the storage of ContractedGraph
+	struct Range
+	{
+		const CompactEdge* first;
+		const CompactEdge* last;
+		const CompactEdge* begin() const	{	return first;	}
+		const CompactEdge* end() const		{	return last;	}
+	};
+	static constexpr std::uint32_t no_middle = std::numeric_limits<std::uint32_t>::max();
+	const std::uint64_t* offsets = nullptr;
+	const CompactEdge* edges = nullptr;
+	const std::uint32_t* middles = nullptr;
+	Range operator[](const std::size_t v) const
+	{
+		return {edges + offsets[v], edges + offsets[v + 1]};
+	}
+};
+
+class QueryWorkspace
+{	// state of ContractedGraph::search, each thread owns one so that queries on a shared graph do not interfere
+	// index 0 belongs to the forward (upward) search and index 1 to the backward (downward) search
+	// instead of resetting V costs, a query resets only the nodes touched by the previous one
+	// it may also cache unpacked shortcuts, so that path queries of the thread skip unpacking the common ones
+	friend class ContractedGraph;
+	public:
+	QueryWorkspace() = default;
+	void set_path_cache_capacity(const std::size_t capacity)
+	{	// capacity is the number of vertices kept in unpacked shortcuts, 0 disables the cache
+		path_cache_capacity = capacity;
+		clear_path_cache();
+	}
+	private:
+	static constexpr long long inf = std::numeric_limits<long long>::max();
+	std::vector<long long> cost[2];
+	// parent[direction][v] is the node v is reached from, it is valid only where cost is not inf
+	std::vector<std::size_t> parent[2];
+	std::vector<Edge> heap[2];
+	std::vector<std::size_t> touched;
+	// node where the shortest path found by the last search joins its forward and backward parts
+	std::size_t meeting = 0;
+	// unpacked[edge id] holds the original ids of a shortcut except its tail
+	// the cache is flushed when it grows beyond its capacity, frequently used shortcuts are cached again soon
+	std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> unpacked;
+	std::size_t path_cache_capacity = 0;
+	std::size_t path_cache_size = 0;
+	// cached shortcuts belong to the graph whose buffer has the id path_cache_owner, 0 is no graph
+	// ids are never reused, unlike addresses of buffers, so a workspace outliving its graph cannot serve the old shortcuts
+	std::uint64_t path_cache_owner = 0;
+	void clear_path_cache()
+	{
+		unpacked.clear();
+		path_cache_size = 0;
+	}
+	void prepare(const std::size_t V)
+	{
+		for(auto v : touched)
+		{
+			cost[0][v] = inf;
+			cost[1][v] = inf;
+		}
+		touched.clear();
+		heap[0].clear();
+		heap[1].clear();
+		if(cost[0].size() < V)
+		{
+			cost[0].resize(V, inf);
+			cost[1].resize(V, inf);
+			parent[0].resize(V);
+			parent[1].resize(V);
+		}
+	}
+	void reach(const std::size_t direction, const std::size_t v, const long long prospective_cost, const std::size_t from)
+	{
+		if(cost[0][v] == inf && cost[1][v] == inf)		touched.push_back(v);
+		cost[direction][v] = prospective_cost;
+		parent[direction][v] = from;
+		heap[direction].push_back({v, prospective_cost});
+		std::push_heap(heap[direction].begin(), heap[direction].end(), Edge{});
+	}
+	Edge pop(const std::size_t direction)
+	{
+		std::pop_heap(heap[direction].begin(), heap[direction].end(), Edge{});
+		const Edge top = heap[direction].back();
+		heap[direction].pop_back();
+		return top;
+	}
+};
+
 class ContractedGraph
-{	// this class has two member variables (adjacency lists)
+{	// this class has two member variables (adjacency arrays)
 	// one of them consists of upward edges only
 	// the other consists of downward edges. 
 	// downward graph is created in transpose form.
+	// vertices are renumbered by contraction order, so upward searches move towards larger ids and nearby memory
+	// ids given to and returned by public functions are the original ones
+	// all arrays live in a single buffer laid out exactly as the file written by save, 
+	// so that load only maps the file into memory and points the arrays into it
+	// the buffer is immutable and shared by copies of the graph
 	friend class Graph;
+	friend class CustomizableGraph;
 	using representation_type = std::vector<std::vector<Edge>>;
-	template<class Type> using priority_queue_type = std::priority_queue<Type, std::vector<Type>, Type>;
 	public:
-	ContractedGraph(std::size_t V = 0) : upward_adj_list(V, std::vector<Edge>()), downward_rev_adj_list(V, std::vector<Edge>()) {}
+	ContractedGraph() = default;
 	long long search(const std::size_t, const std::size_t) const;
-	private:
-	representation_type upward_adj_list;
-	representation_type downward_rev_adj_list;
-	static std::vector<double> dijkstra(const representation_type&, const std::size_t, const std::size_t);
-	void add_upward_edge(std::size_t tail, std::size_t head, long long weight)
-	{
-		upward_adj_list[tail].push_back({head, weight});
+	long long search(const std::size_t, const std::size_t, QueryWorkspace&) const;
+	// vertices of a shortest path from the first vertex to the second one, empty when there is no path
+	std::vector<std::size_t> path(const std::size_t, const std::size_t) const;
+	std::vector<std::size_t> path(const std::size_t, const std::size_t, QueryWorkspace&) const;
+	std::vector<long long> distance_table(const std::vector<std::size_t>&, const std::vector<std::size_t>&, const std::size_t threads = 1) const;
+	std::vector<long long> one_to_all(const std::size_t) const;
+	std::vector<long long> one_to_all(const std::vector<std::size_t>&) const;
+	std::size_t size() const
+	{	// number of vertices
+		return V;
+	}
+	bool valid() const
+	{	// false for a default constructed graph and for one built from weights that do not fit into 32 bits
+		return data != nullptr;
 	}
-	void add_downward_edge(std::size_t tail, std::size_t head, long long weight)
-	{	// downward edges are created in transpose form to be used by modified bidirectional dijkstra
-		downward_rev_adj_list[head].push_back({tail, weight});
+	bool save(const std::string&) const;
+	bool load(const std::string&);
+	private:
+	struct FileHeader
+	{	// a file written by a machine with another byte order or edge layout fails version and edge_size checks
+		static constexpr char expected_magic[8] = {'C', 'H', 'G', 'R', 'A', 'P', 'H', '\0'};
+		static constexpr std::uint32_t expected_version = 3;
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t edge_size;
+		std::uint64_t V;
+		std::uint64_t upward_edge_count;
+		std::uint64_t downward_edge_count;
+	};
+	struct Layout
+	{	// byte offsets of the arrays following the header, each of them starts at a multiple of 8 bytes
+		// counts come from a file which may be corrupted, fits is false when a size does not fit into std::size_t
+		std::size_t ranks, vertices, upward_offsets, downward_offsets, upward_edges, downward_edges, upward_middles, downward_middles, size;
+		bool fits = true;
+		explicit Layout(const FileHeader& header)
+		{
+			constexpr std::size_t max_size = std::numeric_limits<std::size_t>::max();
+			auto array = [this](const std::uint64_t count, const std::size_t element_size)
+			{	// bytes of an array rounded up to a multiple of 8
+				if(count > (max_size - 7) / element_size)
+				{
+					fits = false;
+					return std::size_t{0};
+				}
+				return (static_cast<std::size_t>(count) * element_size + 7) / 8 * 8;
+			};
+			auto after = [this](const std::size_t offset, const std::size_t bytes)
+			{
+				if(bytes > max_size - offset)
+				{
+					fits = false;
+					return std::size_t{0};
+				}
+				return offset + bytes;
+			};
+			const std::uint64_t offset_count = (header.V < max_size) ? header.V + 1 : max_size;
+			ranks = sizeof(FileHeader);
+			vertices = after(ranks, array(header.V, sizeof(std::uint32_t)));
+			upward_offsets = after(vertices, array(header.V, sizeof(std::uint32_t)));
+			downward_offsets = after(upward_offsets, array(offset_count, sizeof(std::uint64_t)));
+			upward_edges = after(downward_offsets, array(offset_count, sizeof(std::uint64_t)));
+			downward_edges = after(upward_edges, array(header.upward_edge_count, sizeof(CompactEdge)));
+			upward_middles = after(downward_edges, array(header.downward_edge_count, sizeof(CompactEdge)));
+			downward_middles = after(upward_middles, array(header.upward_edge_count, sizeof(std::uint32_t)));
+			size = after(downward_middles, array(header.downward_edge_count, sizeof(std::uint32_t)));
+		}
+	};
+	std::shared_ptr<const void> storage;
+	const char* data = nullptr;
+	std::size_t data_size = 0;
+	// id of the buffer, copies of the graph share it and each attached buffer gets a new one
+	std::uint64_t id = 0;
+	static std::atomic<std::uint64_t> last_id;
+	std::size_t V = 0;
+	// ranks[original id] is the renumbered id and vertices[renumbered id] is the original one
+	const std::uint32_t* ranks = nullptr;
+	const std::uint32_t* vertices = nullptr;
+	AdjacencyArray upward_adj_list;
+	AdjacencyArray downward_rev_adj_list;
+	ContractedGraph(const representation_type&, const representation_type&, const std::vector<std::size_t>&);
+	bool attach(std::shared_ptr<const void>, const char*, const std::size_t);
+	const AdjacencyArray& graph(const std::size_t direction) const
+	{	// direction 0 is forward (upward graph) and direction 1 is backward (reversed downward graph)
+		return (direction == 0) ? upward_adj_list : downward_rev_adj_list;
 	}
+	bool is_stalled(const std::size_t, const std::size_t, const long long, const QueryWorkspace&) const;
+	template<class Function> void upward_search(const std::size_t, const std::size_t, QueryWorkspace&, Function&&) const;
+	// costs of a sweep start from half of the range, so adding a 32-bit weight to them never overflows
+	static constexpr long long sweep_inf = std::numeric_limits<long long>::max() / 2;
+	void sweep(const std::size_t*, const std::size_t, long long*, QueryWorkspace&) const;
+	std::uint64_t find_edge(const std::size_t, const std::size_t) const;
+	std::uint32_t middle(const std::uint64_t) const;
+	void unpack(const std::size_t, const std::size_t, std::vector<std::size_t>&) const;
 };
 
-std::vector<double> ContractedGraph::dijkstra(const ContractedGraph::representation_type& adj_list, const std::size_t s, const std::size_t t)
-{	// runs in O(m lgn) time due to min heap data structure
-	priority_queue_type<Edge> q;
-	std::size_t V = adj_list.size();
-	std::vector<double> cost(V, std::numeric_limits<double>::infinity());
-	// initialize for starting vertex
-	q.push({s, 0});
-	cost[s] = 0;
-	while(q.empty() == false)
-	{
-		std::size_t curr = q.top().head;
-		q.pop();
-		// no need to explore further than target
-		if(curr == t)			break;
-		const auto& neighbours = adj_list[curr];
-		for(const auto& neighbour : neighbours)
-		{
-			long long prospective_cost = cost[curr] + neighbour.weight;
-			if(prospective_cost < cost[neighbour.head])
+ContractedGraph::ContractedGraph(const representation_type& upward, const representation_type& downward_rev, const std::vector<std::size_t>& rank)
+{	// flattens the adjacency lists built by Graph::preprocess into a single buffer
+	// adjacency lists, their heads and middles are already renumbered, rank maps original ids to the new ones
+	// edges of a vertex are sorted by head and only the cheapest of parallel edges is kept
+	// edges store 32-bit weights, so if a weight, shortcuts included, is negative or larger, the graph is left empty and invalid
+	const std::size_t vertex_count = upward.size();
+	assert(upward.size() == downward_rev.size() && rank.size() == vertex_count && "vertices count should be the same");
+	assert(vertex_count < std::numeric_limits<std::uint32_t>::max() && "vertex ids should fit into 32 bits");
+	bool weights_fit = true;
+	auto compact = [&weights_fit](const representation_type& adj_list)
+	{
+		representation_type compacted(adj_list.size());
+		for(std::size_t v = 0; v < adj_list.size(); ++v)
+		{
+			std::vector<Edge> edges = adj_list[v];
+			std::sort(edges.begin(), edges.end(), [](const Edge& lhs, const Edge& rhs)
+			{
+				return lhs.head < rhs.head || (lhs.head == rhs.head && lhs.weight < rhs.weight);
+			});
+			for(const auto& edge : edges)
 			{
-				cost[neighbour.head] = prospective_cost;
-				q.push({neighbour.head, prospective_cost});
+				if(edge.weight < 0 || edge.weight > std::numeric_limits<std::uint32_t>::max())		weights_fit = false;
+				if(compacted[v].empty() == true || compacted[v].back().head != edge.head)		compacted[v].push_back(edge);
 			}
 		}
+		return compacted;
+	};
+	auto edge_count = [](const representation_type& adj_list)
+	{
+		std::size_t count = 0;
+		for(const auto& edges : adj_list)		count += edges.size();
+		return count;
+	};
+	const auto compact_upward = compact(upward);
+	const auto compact_downward_rev = compact(downward_rev);
+	if(weights_fit == false)		return;
+	FileHeader header{};
+	std::copy(std::begin(FileHeader::expected_magic), std::end(FileHeader::expected_magic), header.magic);
+	header.version = FileHeader::expected_version;
+	header.edge_size = sizeof(CompactEdge);
+	header.V = vertex_count;
+	header.upward_edge_count = edge_count(compact_upward);
+	header.downward_edge_count = edge_count(compact_downward_rev);
+	const Layout layout(header);
+	// std::uint64_t elements keep the buffer aligned for every array in it
+	auto buffer = std::make_shared<std::vector<std::uint64_t>>(layout.size / sizeof(std::uint64_t), 0);
+	char* bytes = reinterpret_cast<char*>(buffer->data());
+	std::memcpy(bytes, &header, sizeof(FileHeader));
+	std::uint32_t* rank_array = reinterpret_cast<std::uint32_t*>(bytes + layout.ranks);
+	std::uint32_t* vertex_array = reinterpret_cast<std::uint32_t*>(bytes + layout.vertices);
+	for(std::size_t v = 0; v < vertex_count; ++v)
+	{
+		rank_array[v] = static_cast<std::uint32_t>(rank[v]);
+		vertex_array[rank[v]] = static_cast<std::uint32_t>(v);
 	}
-	return cost;
+	auto flatten = [vertex_count](const representation_type& adj_list, std::uint64_t* offsets, CompactEdge* edges, std::uint32_t* middles)
+	{
+		offsets[0] = 0;
+		for(std::size_t v = 0; v < vertex_count; ++v)
+		{
+			for(const auto& edge : adj_list[v])
+			{
+				*edges++ = {static_cast<std::uint32_t>(edge.head), static_cast<std::uint32_t>(edge.weight)};
+				*middles++ = (edge.middle == Edge::none) ? AdjacencyArray::no_middle : static_cast<std::uint32_t>(edge.middle);
+			}
+			offsets[v + 1] = offsets[v] + adj_list[v].size();
+		}
+	};
+	flatten(compact_upward, reinterpret_cast<std::uint64_t*>(bytes + layout.upward_offsets), 
+			reinterpret_cast<CompactEdge*>(bytes + layout.upward_edges), reinterpret_cast<std::uint32_t*>(bytes + layout.upward_middles));
+	flatten(compact_downward_rev, reinterpret_cast<std::uint64_t*>(bytes + layout.downward_offsets), 
+			reinterpret_cast<CompactEdge*>(bytes + layout.downward_edges), reinterpret_cast<std::uint32_t*>(bytes + layout.downward_middles));
+	attach(buffer, bytes, layout.size);
+}
+
+std::atomic<std::uint64_t> ContractedGraph::last_id{0};
+
+bool ContractedGraph::attach(std::shared_ptr<const void> owner, const char* bytes, const std::size_t size)
+{	// validates the buffer and points the arrays into it, the graph is left unchanged on failure
+	// every offset, vertex and middle node is checked once here, so that queries on a corrupted file cannot read out of bounds
+	if(size < sizeof(FileHeader))		return false;
+	FileHeader header;
+	std::memcpy(&header, bytes, sizeof(FileHeader));
+	if(std::equal(std::begin(header.magic), std::end(header.magic), FileHeader::expected_magic) == false)		return false;
+	if(header.version != FileHeader::expected_version || header.edge_size != sizeof(CompactEdge))				return false;
+	// vertex ids and middle nodes are stored in 32 bits and the largest value means no middle
+	if(header.V >= AdjacencyArray::no_middle)		return false;
+	const Layout layout(header);
+	if(layout.fits == false || size != layout.size)			return false;
+	const std::size_t vertex_count = static_cast<std::size_t>(header.V);
+	const std::uint32_t* rank_array = reinterpret_cast<const std::uint32_t*>(bytes + layout.ranks);
+	const std::uint32_t* vertex_array = reinterpret_cast<const std::uint32_t*>(bytes + layout.vertices);
+	for(std::size_t v = 0; v < vertex_count; ++v)
+	{	// ranks and vertices should be inverse permutations
+		if(rank_array[v] >= vertex_count || vertex_array[rank_array[v]] != v)		return false;
+	}
+	auto valid_edges = [vertex_count](const std::uint64_t* offsets, const std::uint64_t edge_count, const CompactEdge* edges, const std::uint32_t* middles)
+	{
+		if(offsets[0] != 0 || offsets[vertex_count] != edge_count)		return false;
+		for(std::size_t v = 0; v < vertex_count; ++v)
+		{
+			if(offsets[v] > offsets[v + 1])		return false;
+		}
+		for(std::uint64_t i = 0; i < edge_count; ++i)
+		{
+			if(edges[i].head >= vertex_count)										return false;
+			if(middles[i] >= vertex_count && middles[i] != AdjacencyArray::no_middle)	return false;
+		}
+		return true;
+	};
+	const std::uint64_t* upward_offsets = reinterpret_cast<const std::uint64_t*>(bytes + layout.upward_offsets);
+	const std::uint64_t* downward_offsets = reinterpret_cast<const std::uint64_t*>(bytes + layout.downward_offsets);
+	if(valid_edges(upward_offsets, header.upward_edge_count, reinterpret_cast<const CompactEdge*>(bytes + layout.upward_edges),
+				   reinterpret_cast<const std::uint32_t*>(bytes + layout.upward_middles)) == false)			return false;
+	if(valid_edges(downward_offsets, header.downward_edge_count, reinterpret_cast<const CompactEdge*>(bytes + layout.downward_edges),
+				   reinterpret_cast<const std::uint32_t*>(bytes + layout.downward_middles)) == false)		return false;
+	storage = std::move(owner);
+	data = bytes;
+	data_size = size;
+	id = ++last_id;
+	V = header.V;
+	ranks = reinterpret_cast<const std::uint32_t*>(bytes + layout.ranks);
+	vertices = reinterpret_cast<const std::uint32_t*>(bytes + layout.vertices);
+	upward_adj_list = {upward_offsets, reinterpret_cast<const CompactEdge*>(bytes + layout.upward_edges), 
+					   reinterpret_cast<const std::uint32_t*>(bytes + layout.upward_middles)};
+	downward_rev_adj_list = {downward_offsets, reinterpret_cast<const CompactEdge*>(bytes + layout.downward_edges), 
+							 reinterpret_cast<const std::uint32_t*>(bytes + layout.downward_middles)};
+	return true;
+}
+
+bool ContractedGraph::save(const std::string& path) const
+{	// the buffer is written as it is, so the file can be mapped back without parsing
+	// an invalid graph has no buffer and nothing is written
+	if(data == nullptr)		return false;
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write(data, static_cast<std::streamsize>(data_size));
+	return file.good();
+}
+
+bool ContractedGraph::load(const std::string& path)
+{	// maps the file read-only, its pages are shared by every process mapping the same file
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if(fd < 0)		return false;
+	struct stat info;
+	if(::fstat(fd, &info) != 0 || info.st_size <= 0)
+	{
+		::close(fd);
+		return false;
+	}
+	const std::size_t size = static_cast<std::size_t>(info.st_size);
+	void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	// mapping stays valid after the file descriptor is closed
+	::close(fd);
+	if(mapping == MAP_FAILED)		return false;
+	std::shared_ptr<const void> owner(mapping, [size](const void* address)
+	{
+		::munmap(const_cast<void*>(address), size);
+	});
+	return attach(std::move(owner), static_cast<const char*>(mapping), size);
 }
 
 long long ContractedGraph::search(const std::size_t u, const std::size_t v) const
-{	// modified bidirectional dijkstra algorithm
-	assert(upward_adj_list.size() == downward_rev_adj_list.size() && "vertices count should be the same");
-	const std::size_t V = upward_adj_list.size();
-	auto cost_from_u = ContractedGraph::dijkstra(upward_adj_list, u, v);
-	auto cost_from_v = ContractedGraph::dijkstra(downward_rev_adj_list, v, u);
-	double cost = std::numeric_limits<double>::infinity();
-	for(std::size_t w = 0; w < V; ++w)
-	{	// find the vertex that causes minimum cost overall
-		// forward and backward paths are connected at this vertex w
-		cost = std::min(cost, cost_from_u[w] + cost_from_v[w]);
-	}
-	return static_cast<long long>(std::isinf(cost) ? (-1) : (cost));
+{	// each thread reuses its own workspace
+	thread_local QueryWorkspace workspace;
+	return search(u, v, workspace);
+}
+
+long long ContractedGraph::search(const std::size_t u, const std::size_t v, QueryWorkspace& workspace) const
+{	// modified bidirectional dijkstra algorithm, forward search runs on upward graph and backward search on reversed downward graph
+	// searches are interleaved, the one with the smaller queue minimum goes next
+	// a search stops when its minimum is not less than the best meeting cost, 
+	// since every later meeting through it would cost at least that much
+	// stall-on-demand: a node whose cost is beaten through an edge of the other graph is not on a shortest path,
+	// so its edges are not relaxed
+	workspace.prepare(V);
+	const std::size_t s = ranks[u];
+	const std::size_t t = ranks[v];
+	auto& heap = workspace.heap;
+	auto& cost = workspace.cost;
+	const long long inf = QueryWorkspace::inf;
+	long long best = inf;
+	workspace.reach(0, s, 0, s);
+	workspace.reach(1, t, 0, t);
+	workspace.meeting = s;
+	while(true)
+	{
+		const bool is_forward_active = heap[0].empty() == false && heap[0].front().weight < best;
+		const bool is_backward_active = heap[1].empty() == false && heap[1].front().weight < best;
+		if(is_forward_active == false && is_backward_active == false)		break;
+		const std::size_t direction = (is_forward_active == true && (is_backward_active == false || heap[0].front().weight <= heap[1].front().weight)) ? 0 : 1;
+		const Edge top = workspace.pop(direction);
+		const std::size_t curr = top.head;
+		// skip the entries pushed before the cost of the node was decreased
+		if(top.weight > cost[direction][curr])		continue;
+		if(cost[1 - direction][curr] != inf)
+		{	// forward and backward paths are connected at curr
+			if(top.weight + cost[1 - direction][curr] < best)
+			{
+				best = top.weight + cost[1 - direction][curr];
+				workspace.meeting = curr;
+			}
+		}
+		if(is_stalled(direction, curr, top.weight, workspace) == true)		continue;
+		for(const auto& edge : graph(direction)[curr])
+		{
+			long long prospective_cost = top.weight + edge.weight;
+			if(prospective_cost < cost[direction][edge.head])
+			{
+				workspace.reach(direction, edge.head, prospective_cost, curr);
+			}
+		}
+	}
+	return (best == inf) ? -1 : best;
+}
+
+std::vector<std::size_t> ContractedGraph::path(const std::size_t u, const std::size_t v) const
+{	// each thread reuses its own workspace
+	thread_local QueryWorkspace workspace;
+	return path(u, v, workspace);
+}
+
+std::vector<std::size_t> ContractedGraph::path(const std::size_t u, const std::size_t v, QueryWorkspace& workspace) const
+{	// the search leaves a path of hierarchy edges through the meeting node, then each of its shortcuts is unpacked
+	// only these top level shortcuts are cached, a cached one already contains the shortcuts below it
+	std::vector<std::size_t> vertices_on_path;
+	if(search(u, v, workspace) == -1)		return vertices_on_path;
+	const std::size_t s = ranks[u];
+	const std::size_t t = ranks[v];
+	// forward part is followed from the meeting node back to s and backward part from it to t
+	std::vector<std::size_t> hierarchy_path;
+	for(std::size_t x = workspace.meeting; x != s; x = workspace.parent[0][x])		hierarchy_path.push_back(x);
+	hierarchy_path.push_back(s);
+	std::reverse(hierarchy_path.begin(), hierarchy_path.end());
+	for(std::size_t x = workspace.meeting; x != t; )
+	{
+		x = workspace.parent[1][x];
+		hierarchy_path.push_back(x);
+	}
+	if(workspace.path_cache_owner != id)
+	{
+		workspace.clear_path_cache();
+		workspace.path_cache_owner = id;
+	}
+	vertices_on_path.push_back(u);
+	for(std::size_t i = 1; i < hierarchy_path.size(); ++i)
+	{
+		const std::size_t tail = hierarchy_path[i - 1], head = hierarchy_path[i];
+		if(workspace.path_cache_capacity == 0)
+		{
+			unpack(tail, head, vertices_on_path);
+			continue;
+		}
+		const std::uint64_t edge_id = find_edge(tail, head);
+		if(middle(edge_id) == AdjacencyArray::no_middle)
+		{
+			vertices_on_path.push_back(vertices[head]);
+			continue;
+		}
+		const auto cached = workspace.unpacked.find(edge_id);
+		if(cached != workspace.unpacked.end())
+		{
+			vertices_on_path.insert(vertices_on_path.end(), cached->second.begin(), cached->second.end());
+			continue;
+		}
+		const std::size_t first = vertices_on_path.size();
+		unpack(tail, head, vertices_on_path);
+		const std::size_t count = vertices_on_path.size() - first;
+		if(workspace.path_cache_size + count > workspace.path_cache_capacity)		workspace.clear_path_cache();
+		if(count <= workspace.path_cache_capacity)
+		{
+			workspace.unpacked.emplace(edge_id, std::vector<std::uint32_t>(vertices_on_path.begin() + first, vertices_on_path.end()));
+			workspace.path_cache_size += count;
+		}
+	}
+	return vertices_on_path;
+}
+
+std::uint64_t ContractedGraph::find_edge(const std::size_t tail, const std::size_t head) const
+{	// returns the id of the hierarchy edge from renumbered vertex tail to head, ids of downward edges follow the upward ones
+	// edges of a vertex are sorted by head, so it is found by binary search
+	const bool is_upward = tail < head;
+	const AdjacencyArray& adj_list = is_upward ? upward_adj_list : downward_rev_adj_list;
+	const std::size_t from = is_upward ? tail : head;
+	const std::size_t to = is_upward ? head : tail;
+	const auto edges = adj_list[from];
+	const CompactEdge* edge = std::lower_bound(edges.begin(), edges.end(), to, [](const CompactEdge& lhs, const std::size_t rhs)
+	{
+		return lhs.head < rhs;
+	});
+	assert(edge != edges.end() && edge->head == to && "edges of a shortest path should be in the hierarchy");
+	const std::uint64_t index = static_cast<std::uint64_t>(edge - adj_list.edges);
+	return is_upward ? index : upward_adj_list.offsets[V] + index;
+}
+
+std::uint32_t ContractedGraph::middle(const std::uint64_t edge_id) const
+{
+	const std::uint64_t upward_edge_count = upward_adj_list.offsets[V];
+	return (edge_id < upward_edge_count) ? upward_adj_list.middles[edge_id] : downward_rev_adj_list.middles[edge_id - upward_edge_count];
+}
+
+void ContractedGraph::unpack(const std::size_t tail, const std::size_t head, std::vector<std::size_t>& vertices_on_path) const
+{	// appends the original ids of the vertices after tail up to head on the edge from renumbered vertex tail to head
+	// a shortcut tail -> head stands for tail -> middle -> head, where middle is lower than both of them
+	// an explicit stack replaces recursion, the first half of a shortcut is on top so vertices are appended in path order
+	std::vector<std::pair<std::size_t, std::size_t>> stack{{tail, head}};
+	while(stack.empty() == false)
+	{
+		const auto [from, to] = stack.back();
+		stack.pop_back();
+		const std::uint32_t m = middle(find_edge(from, to));
+		if(m == AdjacencyArray::no_middle)
+		{
+			vertices_on_path.push_back(vertices[to]);
+		}
+		else
+		{
+			stack.push_back({m, to});
+			stack.push_back({from, m});
+		}
+	}
+}
+
+bool ContractedGraph::is_stalled(const std::size_t direction, const std::size_t v, const long long cost, const QueryWorkspace& workspace) const
+{	// stall-on-demand: a node whose cost is beaten through an edge of the other graph is not on a shortest path,
+	// so its edges need not be relaxed
+	// edges of the other graph at v come from higher nodes in this direction
+	const auto& costs = workspace.cost[direction];
+	for(const auto& edge : graph(1 - direction)[v])
+	{
+		if(costs[edge.head] != QueryWorkspace::inf && costs[edge.head] + edge.weight < cost)		return true;
+	}
+	return false;
+}
+
+template<class Function> void ContractedGraph::upward_search(const std::size_t direction, const std::size_t s, QueryWorkspace& workspace, Function&& settle) const
+{	// complete search from renumbered vertex s in one direction, it only climbs the hierarchy so its search space is small
+	// settle(v, cost) is called for each settled vertex which is not stalled
+	workspace.prepare(V);
+	workspace.reach(direction, s, 0, s);
+	while(workspace.heap[direction].empty() == false)
+	{
+		const Edge top = workspace.pop(direction);
+		const std::size_t curr = top.head;
+		if(top.weight > workspace.cost[direction][curr])				continue;
+		if(is_stalled(direction, curr, top.weight, workspace) == true)		continue;
+		settle(curr, top.weight);
+		for(const auto& edge : graph(direction)[curr])
+		{
+			long long prospective_cost = top.weight + edge.weight;
+			if(prospective_cost < workspace.cost[direction][edge.head])
+			{
+				workspace.reach(direction, edge.head, prospective_cost, curr);
+			}
+		}
+	}
+}
+
+std::vector<long long> ContractedGraph::distance_table(const std::vector<std::size_t>& sources, const std::vector<std::size_t>& targets, const std::size_t threads) const
+{	// returns costs from each source to each target in row-major order, -1 when there is no path
+	// instead of |S| x |T| point-to-point queries, |S| + |T| upward searches are run
+	// first, a backward search from each target leaves (target, cost) in a bucket at each vertex it settles
+	// then, a forward search from each source meets the targets in the buckets of the vertices it settles,
+	// the highest vertex of a shortest path is settled by both searches
+	struct BucketEntry
+	{
+		std::size_t target;
+		long long cost;
+	};
+	const std::size_t S = sources.size(), T = targets.size();
+	std::vector<QueryWorkspace> workspaces(std::max<std::size_t>(threads, 1));
+	std::vector<std::vector<std::pair<std::size_t, BucketEntry>>> entries(workspaces.size());
+	parallel_for(threads, T, [&](std::size_t thread, std::size_t j)
+	{
+		upward_search(1, ranks[targets[j]], workspaces[thread], [&](std::size_t v, long long cost)
+		{
+			entries[thread].push_back({v, {j, cost}});
+		});
+	});
+	// group the entries by vertex, bucket of v is buckets[bucket_offsets[v]] ... buckets[bucket_offsets[v + 1] - 1]
+	std::vector<std::size_t> bucket_offsets(V + 1, 0);
+	for(const auto& thread_entries : entries)
+	{
+		for(const auto& entry : thread_entries)		++bucket_offsets[entry.first + 1];
+	}
+	std::partial_sum(bucket_offsets.begin(), bucket_offsets.end(), bucket_offsets.begin());
+	std::vector<BucketEntry> buckets(bucket_offsets[V]);
+	{
+		std::vector<std::size_t> next(bucket_offsets.begin(), bucket_offsets.end() - 1);
+		for(auto& thread_entries : entries)
+		{
+			for(const auto& entry : thread_entries)		buckets[next[entry.first]++] = entry.second;
+			std::vector<std::pair<std::size_t, BucketEntry>>().swap(thread_entries);
+		}
+	}
+	std::vector<long long> table(S * T, QueryWorkspace::inf);
+	parallel_for(threads, S, [&](std::size_t thread, std::size_t i)
+	{	// each row is written by a single thread
+		long long* row = table.data() + i * T;
+		upward_search(0, ranks[sources[i]], workspaces[thread], [&](std::size_t v, long long cost)
+		{
+			for(std::size_t b = bucket_offsets[v]; b < bucket_offsets[v + 1]; ++b)
+			{
+				row[buckets[b].target] = std::min(row[buckets[b].target], cost + buckets[b].cost);
+			}
+		});
+	});
+	std::replace(table.begin(), table.end(), QueryWorkspace::inf, -1LL);
+	return table;
+}
+
+std::vector<long long> ContractedGraph::one_to_all(const std::size_t s) const
+{	// returns costs from s to each vertex, -1 when there is no path
+	return one_to_all(std::vector<std::size_t>{s});
+}
+
+std::vector<long long> ContractedGraph::one_to_all(const std::vector<std::size_t>& sources) const
+{	// returns costs from each source to each vertex in row-major order, -1 when there is no path
+	// sources are swept in groups of sweep_width so that costs of a vertex for the whole group fit into a cache line
+	constexpr std::size_t sweep_width = 8;
+	const std::size_t S = sources.size();
+	std::vector<long long> costs(S * V);
+	std::vector<long long> group_costs(sweep_width * V);
+	QueryWorkspace workspace;
+	for(std::size_t first = 0; first < S; first += sweep_width)
+	{
+		const std::size_t width = std::min(sweep_width, S - first);
+		sweep(sources.data() + first, width, group_costs.data(), workspace);
+		for(std::size_t v = 0; v < V; ++v)
+		{	// group costs are indexed by renumbered vertices, results by original ones
+			for(std::size_t k = 0; k < width; ++k)
+			{
+				const long long cost = group_costs[v * width + k];
+				costs[(first + k) * V + vertices[v]] = (cost >= sweep_inf) ? -1 : cost;
+			}
+		}
+	}
+	return costs;
+}
+
+void ContractedGraph::sweep(const std::size_t* sources, const std::size_t width, long long* costs, QueryWorkspace& workspace) const
+{	// PHAST: costs[v * width + k] becomes the cost from sources[k] to renumbered vertex v
+	// an upward search from each source sets the costs of the vertices it settles
+	// then the shortest path to any vertex is an upward part followed by downward edges,
+	// so one pass over vertices in descending rank along downward edges completes every cost
+	// the costs of a vertex for all sources are adjacent, hence the innermost loop is over contiguous memory and can be vectorised
+	// costs which are not less than sweep_inf mean there is no path
+	std::fill(costs, costs + width * V, sweep_inf);
+	for(std::size_t k = 0; k < width; ++k)
+	{
+		upward_search(0, ranks[sources[k]], workspace, [&](std::size_t v, long long cost)
+		{
+			costs[v * width + k] = cost;
+		});
+	}
+	for(std::size_t v = V; v-- > 0; )
+	{	// tails of the downward edges into v are higher, so their costs are already final
+		long long* head_costs = costs + v * width;
+		for(const auto& edge : downward_rev_adj_list[v])
+		{
+			const long long* tail_costs = costs + edge.head * width;
+			const long long weight = edge.weight;
+			for(std::size_t k = 0; k < width; ++k)
+			{
+				head_costs[k] = std::min(head_costs[k], tail_costs[k] + weight);
+			}
+		}
+	}
+}
+
+class WitnessSearch
+{	// workspace of the local dijkstra searches run during contraction, each thread owns one
+	// instead of resetting V costs before every search, a cost is valid only when its stamp equals the current one
+	// so a search only touches the nodes it explores
+	// a search also stops after settling settled_limit nodes and does not extend paths beyond hop_limit edges
+	// stopping early never makes the hierarchy wrong, it may only add shortcuts which are not necessary
+	using representation_type = std::vector<std::vector<Edge>>;
+	public:
+	WitnessSearch(std::size_t V, std::size_t _hop_limit, std::size_t _settled_limit)
+		:	costs(V), hops(V), stamps(V, 0), hop_limit{_hop_limit}, settled_limit{_settled_limit} {}
+	void run(const representation_type&, const std::size_t, const std::size_t, const long long, const std::vector<bool>&);
+	long long cost(const std::size_t v) const
+	{	// nodes which are not reached by the last search have infinite cost
+		return (stamps[v] == stamp) ? costs[v] : std::numeric_limits<long long>::max();
+	}
+	private:
+	std::vector<long long> costs;
+	std::vector<std::size_t> hops;
+	std::vector<unsigned> stamps;
+	// heap storage is kept between searches, std::priority_queue cannot be cleared without releasing it
+	std::vector<Edge> heap;
+	unsigned stamp = 0;
+	std::size_t hop_limit;
+	std::size_t settled_limit;
+	void reach(const std::size_t v, const long long cost, const std::size_t hop)
+	{
+		costs[v] = cost;
+		hops[v] = hop;
+		stamps[v] = stamp;
+		heap.push_back({v, cost});
+		std::push_heap(heap.begin(), heap.end(), Edge{});
+	}
+};
+
+void WitnessSearch::run(const representation_type& adj_list, const std::size_t u, const std::size_t v, const long long Pmax, const std::vector<bool>& contracted)
+{	// search shortest paths from u excluding v until cost is greater than Pmax
+	// v is the node to be contracted
+	// u is the source vertex
+	if(++stamp == 0)
+	{	// stamps wrapped around, so the stale ones are cleared once in 2^32 searches
+		std::fill(stamps.begin(), stamps.end(), 0);
+		stamp = 1;
+	}
+	heap.clear();
+	reach(u, 0, 0);
+	std::size_t settled = 0;
+	while(heap.empty() == false)
+	{	
+		if(heap.front().weight > Pmax)		break;
+		std::pop_heap(heap.begin(), heap.end(), Edge{});
+		const Edge top = heap.back();
+		heap.pop_back();
+		// skip the entries pushed before the cost of the node was decreased
+		if(top.weight > costs[top.head])		continue;
+		if(++settled > settled_limit)			break;
+		const std::size_t curr = top.head;
+		if(hops[curr] >= hop_limit)				continue;
+		for(const auto& neighbour : adj_list[curr])
+		{	// explore in original graph excluding contracted nodes and vertex v
+			// when a vertex is contracted, edges are not deleted instead a cheaper version (bool flag is used)
+			if(contracted[neighbour.head] == false && neighbour.head != v)
+			{
+				long long prospective_cost = costs[curr] + neighbour.weight;
+				if(prospective_cost < cost(neighbour.head))
+				{
+					reach(neighbour.head, prospective_cost, hops[curr] + 1);
+				}
+			}
+		}
+	}
 }
 
 class Graph
@@ -105,12 +838,18 @@ class Graph
 	template<class Type> using priority_queue_type = std::priority_queue<Type, std::vector<Type>, Type>;
 	public:
 	Graph(std::size_t V) : adj_list(V, std::vector<Edge>()), rev_adj_list(V, std::vector<Edge>()) {}
-	void add_edge(std::size_t tail, std::size_t head, long long weight)
-	{
-		adj_list[tail].push_back({head, weight});
-		rev_adj_list[head].push_back({tail, weight});
+	void add_edge(std::size_t tail, std::size_t head, long long weight, std::size_t middle = Edge::none)
+	{	// middle is given for shortcuts only
+		adj_list[tail].push_back({head, weight, middle});
+		rev_adj_list[head].push_back({tail, weight, middle});
+	}
+	// with more than one thread, independent sets of nodes are contracted in parallel
+	ContractedGraph preprocess(const std::size_t threads = 1);
+	void set_witness_limits(std::size_t hop_limit, std::size_t settled_limit)
+	{	// smaller limits speed up preprocessing at the expense of unnecessary shortcuts
+		witness_hop_limit = hop_limit;
+		witness_settled_limit = settled_limit;
 	}
-	ContractedGraph preprocess();
 	private:
 	struct Node
 	{	// this class is for node ordering
@@ -123,52 +862,27 @@ class Graph
 	};
 	representation_type adj_list;
 	representation_type rev_adj_list;
+	std::size_t witness_hop_limit = 16;
+	std::size_t witness_settled_limit = 1000;
 	// the following can be used to return to original graph
 	// std::vector<std::size_t> shortcut_count;
 	// std::vector<std::size_t> rev_shortcut_count;
-	std::vector<long long> local_dijkstra(std::size_t, std::size_t, long long, const std::vector<bool>&) const;
-	template<class Type> long long shortcut(const std::size_t, const std::vector<bool>&);
+	template<class Type> long long shortcut(const std::size_t, const std::vector<bool>&, WitnessSearch&, std::vector<Shortcut>* = nullptr);
 	long long contracted_neighbours(std::size_t, const std::vector<bool>&) const;
-	inline long long edge_difference(const std::size_t v, const std::vector<bool>& contracted)
+	bool is_local_minimum(std::size_t, const std::vector<long long>&, const std::vector<bool>&) const;
+	std::vector<std::size_t> contract();
+	void contract_lazily(const std::vector<std::size_t>&, const std::vector<long long>&, std::vector<bool>&, std::vector<std::size_t>&, WitnessSearch&);
+	std::vector<std::size_t> contract_in_parallel(const std::size_t);
+	inline long long edge_difference(const std::size_t v, const std::vector<bool>& contracted, WitnessSearch& witness_search)
 	{	// return edge_difference of uncontracted node v
-		return shortcut<OnlyCountShortcuts>(v, contracted) - static_cast<long long>(adj_list[v].size() + rev_adj_list[v].size());
+		return shortcut<OnlyCountShortcuts>(v, contracted, witness_search) - static_cast<long long>(adj_list[v].size() + rev_adj_list[v].size());
 	}
 };
 
-std::vector<long long> Graph::local_dijkstra(std::size_t u, std::size_t v, long long Pmax, const std::vector<bool>& contracted) const
-{	// search shortest paths from u excluding v until cost is greater than Pmax
-	// v is the node to be contracted
-	// u is the source vertex
-	const std::size_t V = adj_list.size();
-	std::vector<long long> cost(V, std::numeric_limits<long long>::max());
-	priority_queue_type<Edge> q;
-	q.push({u, 0});
-	cost[u] = 0;
-	while(q.empty() == false)
-	{	
-		if(q.top().weight > Pmax)		break;
-		std::size_t curr = q.top().head;
-		q.pop();
-		for(const auto& neighbour : adj_list[curr])
-		{	// explore in original graph excluding contracted nodes and vertex v
-			// when a vertex is contracted, edges are not deleted instead a cheaper version (bool flag is used)
-			if(contracted[neighbour.head] == false && neighbour.head != v)
-			{
-				long long prospective_cost = cost[curr] + neighbour.weight;
-				if(prospective_cost < cost[neighbour.head])
-				{
-					cost[neighbour.head] = prospective_cost;
-					q.push({neighbour.head, prospective_cost});
-				}
-			}
-		}
-	}
-	return cost;
-}
-
-template<class Type> long long Graph::shortcut(const std::size_t v, const std::vector<bool>& contracted)
-{	// two different instantiation is possible due to static_assert
-	// those are CreateAndCountShortcuts and OnlyCountShortcuts
+template<class Type> long long Graph::shortcut(const std::size_t v, const std::vector<bool>& contracted, WitnessSearch& witness_search, std::vector<Shortcut>* collected)
+{	// three different instantiation is possible due to static_assert
+	// those are CreateAndCountShortcuts, OnlyCountShortcuts and CollectShortcuts
+	// CollectShortcuts does not modify the graph, instead shortcuts are appended to collected
 	// if contracted[vertex] is true, then that vertex and the edges adjacent to it do not exist
 	long long count = 0;
 	if(adj_list[v].empty() == true)		return count;
@@ -181,25 +895,29 @@ template<class Type> long long Graph::shortcut(const std::size_t v, const std::v
 		if(contracted[u.head] == false)
 		{
 			long long Pmax = u.weight + w_max_weight;
-			// run local_dijkstra algorithm which returns an std::vector
-			auto dist_from_u_to = local_dijkstra(u.head, v, Pmax, contracted);
+			// run local dijkstra algorithm whose costs are kept in the workspace
+			witness_search.run(adj_list, u.head, v, Pmax, contracted);
 			for(auto& w : adj_list[v])
 			{	
 				if(contracted[w.head] == false)
 				{	// check if u - v - w path is the shortest
 					long long Pw = u.weight + w.weight;
-					if(dist_from_u_to[w.head] > Pw)
+					if(witness_search.cost(w.head) > Pw)
 					{	// if so, add a shortcut edge from u to w with weight Pw
 						if constexpr (std::is_same<Type, CreateAndCountShortcuts>::value)
 						{	// with c++17 std::is_same_v can be used
-							add_edge(u.head, w.head, Pw);
+							add_edge(u.head, w.head, Pw, v);
 							// ++shortcut_count[u.head];
 							// ++rev_shortcut_count[w.head];
 						}
+						else if constexpr (std::is_same<Type, CollectShortcuts>::value)
+						{
+							collected->push_back({u.head, w.head, Pw, v});
+						}
 						else
 						{
 							static_assert(std::is_same<Type, OnlyCountShortcuts>::value, 
-							"only CreateAndCountShortcuts and OnlyCountShortcuts types are allowed");
+							"only CreateAndCountShortcuts, OnlyCountShortcuts and CollectShortcuts types are allowed");
 						}
 						++count;
 					}
@@ -224,78 +942,646 @@ long long Graph::contracted_neighbours(std::size_t v, const std::vector<bool>& c
 	return count;
 }
 
-ContractedGraph Graph::preprocess()
-{
+bool Graph::is_local_minimum(std::size_t v, const std::vector<long long>& importance, const std::vector<bool>& contracted) const
+{	// checks whether v is less important than each of its uncontracted neighbours, ties are broken by id
+	auto is_less_important = [&](const std::size_t u)
+	{
+		return importance[v] < importance[u] || (importance[v] == importance[u] && v < u);
+	};
+	for(const auto& neighbour : adj_list[v])
+	{
+		if(contracted[neighbour.head] == false && neighbour.head != v && is_less_important(neighbour.head) == false)		return false;
+	}
+	for(const auto& neighbour : rev_adj_list[v])
+	{
+		if(contracted[neighbour.head] == false && neighbour.head != v && is_less_important(neighbour.head) == false)		return false;
+	}
+	return true;
+}
+
+std::vector<std::size_t> Graph::contract()
+{	// contracts nodes one at a time and returns the contraction order of each node
 	const std::size_t V = adj_list.size();
-	// find node ordering 
-	priority_queue_type<Node> nodes;
 	// instead of removing edges the following bool vector is used to differentiate contracted and uncontracted vertices
 	std::vector<bool> contracted(V, false);
+	std::vector<std::size_t> contraction_order(V, 0);
+	WitnessSearch witness_search(V, witness_hop_limit, witness_settled_limit);
+	std::vector<std::size_t> nodes(V);
+	std::iota(nodes.begin(), nodes.end(), 0);
+	std::vector<long long> importance(V, 0);
 	for(std::size_t v = 0; v < V; ++v)
 	{
-		nodes.push({v, edge_difference(v, contracted)});
+		importance[v] = edge_difference(v, contracted, witness_search);
+	}
+	contract_lazily(nodes, importance, contracted, contraction_order, witness_search);
+	return contraction_order;
+}
+
+void Graph::contract_lazily(const std::vector<std::size_t>& remaining, const std::vector<long long>& importance, std::vector<bool>& contracted, 
+							std::vector<std::size_t>& contraction_order, WitnessSearch& witness_search)
+{	// contracts the remaining nodes one at a time, the nodes which are not remaining have already been contracted
+	// find node ordering 
+	priority_queue_type<Node> nodes;
+	for(auto v : remaining)
+	{
+		nodes.push({v, importance[v]});
 	}
 	// contract nodes
-	std::size_t order = 0;
-	std::vector<std::size_t> contraction_order(V, 0);
+	std::size_t order = contraction_order.size() - remaining.size();
 	while(nodes.empty() == false)
 	{	// contract in the order of increasing importance
 		auto node = nodes.top();
 		nodes.pop();
 		// recompute importance of the node
 		// edge difference and contracted_neighbours change in each iteration 
-		node.importance = edge_difference(node.id, contracted) + contracted_neighbours(node.id, contracted);		
+		node.importance = edge_difference(node.id, contracted, witness_search) + contracted_neighbours(node.id, contracted);		
 		if(nodes.empty() == false && node.importance > nodes.top().importance)
 		{	// if it is not the smallest anymore, push it back then continue (lazy update)
 			nodes.push(node);
 			continue;
 		}	// contract the node
 		std::size_t v = node.id;
-		shortcut<CreateAndCountShortcuts>(v, contracted);
+		shortcut<CreateAndCountShortcuts>(v, contracted, witness_search);
 		contracted[v] = true;
 		contraction_order[v] = ++order;
 	}
+}
+
+std::vector<std::size_t> Graph::contract_in_parallel(const std::size_t threads)
+{	// contracts nodes in rounds and returns the contraction order of each node
+	// in each round, nodes less important than all of their uncontracted neighbours are selected
+	// no two selected nodes are adjacent, so their shortcuts can be searched in parallel and merged afterwards
+	// selected nodes are excluded from each other's witness searches, 
+	// otherwise two of them could drop shortcuts by relying on witnesses passing through each other
+	// once a round cannot keep every thread busy, the dense core is left and it is contracted lazily on one thread,
+	// since recomputing the importance of all neighbours in each round costs more there than it gains
+	const std::size_t V = adj_list.size();
+	std::vector<bool> contracted(V, false);
+	std::vector<long long> importance(V, 0);
+	std::vector<WitnessSearch> witness_searches(threads, WitnessSearch(V, witness_hop_limit, witness_settled_limit));
+	parallel_for(threads, V, [&](std::size_t thread, std::size_t v)
+	{
+		importance[v] = edge_difference(v, contracted, witness_searches[thread]);
+	});
+	std::vector<std::size_t> remaining(V);
+	std::iota(remaining.begin(), remaining.end(), 0);
+	std::size_t order = 0;
+	std::vector<std::size_t> contraction_order(V, 0);
+	// contracted vertices together with the vertices selected in the current round
+	std::vector<bool> blocked(V, false);
+	std::vector<bool> is_neighbour(V, false);
+	std::vector<std::vector<Shortcut>> collected(threads);
+	while(remaining.empty() == false)
+	{	// select an independent set, the least important remaining node is always selected
+		std::vector<char> is_selected(remaining.size(), false);
+		parallel_for(threads, remaining.size(), [&](std::size_t, std::size_t i)
+		{
+			is_selected[i] = is_local_minimum(remaining[i], importance, contracted);
+		});
+		std::vector<std::size_t> selected;
+		for(std::size_t i = 0; i < remaining.size(); ++i)
+		{
+			if(is_selected[i] == true)		selected.push_back(remaining[i]);
+		}
+		if(selected.size() < threads)
+		{
+			contract_lazily(remaining, importance, contracted, contraction_order, witness_searches[0]);
+			break;
+		}
+		for(auto v : selected)		blocked[v] = true;
+		// search shortcuts of the selected nodes in parallel, then add them to the graph
+		parallel_for(threads, selected.size(), [&](std::size_t thread, std::size_t i)
+		{
+			shortcut<CollectShortcuts>(selected[i], blocked, witness_searches[thread], &collected[thread]);
+		});
+		for(auto& shortcuts : collected)
+		{
+			for(const auto& shortcut : shortcuts)		add_edge(shortcut.tail, shortcut.head, shortcut.weight, shortcut.middle);
+			shortcuts.clear();
+		}
+		for(auto v : selected)
+		{
+			contracted[v] = true;
+			contraction_order[v] = ++order;
+		}
+		// only the importance of the neighbours of contracted nodes changes
+		std::vector<std::size_t> neighbours;
+		for(auto v : selected)
+		{
+			for(const auto* list : {&adj_list[v], &rev_adj_list[v]})
+			{
+				for(const auto& neighbour : *list)
+				{
+					if(contracted[neighbour.head] == false && is_neighbour[neighbour.head] == false)
+					{
+						is_neighbour[neighbour.head] = true;
+						neighbours.push_back(neighbour.head);
+					}
+				}
+			}
+		}
+		parallel_for(threads, neighbours.size(), [&](std::size_t thread, std::size_t i)
+		{
+			const std::size_t u = neighbours[i];
+			importance[u] = edge_difference(u, contracted, witness_searches[thread]) + contracted_neighbours(u, contracted);
+		});
+		for(auto u : neighbours)		is_neighbour[u] = false;
+		remaining.erase(std::remove_if(remaining.begin(), remaining.end(), [&](const std::size_t v)
+		{
+			return contracted[v];
+		}), remaining.end());
+	}
+	return contraction_order;
+}
+
+ContractedGraph Graph::preprocess(const std::size_t threads)
+{
+	const std::size_t V = adj_list.size();
+	// find node ordering and contract nodes
+	std::vector<std::size_t> contraction_order = (threads > 1) ? contract_in_parallel(threads) : contract();
+	// vertices of upward and downward graphs are renumbered by contraction order
+	std::vector<std::size_t> rank(V);
+	for(std::size_t v = 0; v < V; ++v)
+	{
+		rank[v] = contraction_order[v] - 1;
+	}
 	// create upward and downward graphs
-	ContractedGraph preprocessed(V);
+	representation_type upward_adj_list(V, std::vector<Edge>());
+	representation_type downward_rev_adj_list(V, std::vector<Edge>());
 	for(std::size_t u = 0; u < V; ++u)
 	{
 		for(auto& v : adj_list[u])
 		{
+			const std::size_t middle = (v.middle == Edge::none) ? Edge::none : rank[v.middle];
 			if(contraction_order[u] < contraction_order[v.head])
 			{
-				preprocessed.add_upward_edge(u, v.head, v.weight);
+				upward_adj_list[rank[u]].push_back({rank[v.head], v.weight, middle});
 			} 
 			else
+			{	// downward edges are created in transpose form to be used by modified bidirectional dijkstra
+				downward_rev_adj_list[rank[v.head]].push_back({rank[u], v.weight, middle});
+			}
+		}
+	}
+	return ContractedGraph(upward_adj_list, downward_rev_adj_list, rank);
+}
+
+class CustomizableGraph
+{	// fixes the contraction order and the shortcuts once, so that new edge weights are applied without preprocessing again
+	// shortcuts found by witness searches are necessary only for the weights they were searched with,
+	// that is why the topology consists of every shortcut the order may need for any weights:
+	// contracting v adds a shortcut from each higher in-neighbour u to each higher out-neighbour w
+	// the order of Graph::preprocess leaves a dense core that turns into a near clique this way,
+	// hence vertices are ordered by minimum degree in the undirected graph, which keeps the added shortcuts few
+	// each (u - v - w) triangle is recorded in contraction order, hence customize is one linear bottom-up pass over them
+	using representation_type = std::vector<std::vector<Edge>>;
+	public:
+	CustomizableGraph(std::size_t, const std::vector<std::pair<std::size_t, std::size_t>>&);
+	ContractedGraph customize(const std::vector<long long>&) const;
+	std::size_t arc_count() const
+	{	// number of edges and shortcuts in the topology
+		return arcs.size();
+	}
+	std::size_t triangle_count() const
+	{
+		return triangles.size();
+	}
+	private:
+	void order_by_minimum_degree(const std::vector<std::pair<std::size_t, std::size_t>>&);
+	struct Arc
+	{	// ends are renumbered vertices
+		std::uint32_t tail;
+		std::uint32_t head;
+	};
+	struct Triangle
+	{	// arcs u -> v, v -> w and u -> w where v is the lowest, so u -> w may be replaced with u -> v -> w
+		std::uint32_t first;
+		std::uint32_t second;
+		std::uint32_t shortcut;
+	};
+	static constexpr std::uint32_t no_arc = std::numeric_limits<std::uint32_t>::max();
+	std::vector<std::size_t> rank;
+	std::vector<Arc> arcs;
+	// arc of each input edge, no_arc for loops
+	std::vector<std::uint32_t> edge_arcs;
+	std::vector<Triangle> triangles;
+};
+
+void CustomizableGraph::order_by_minimum_degree(const std::vector<std::pair<std::size_t, std::size_t>>& edges)
+{	// contracts the vertex with the fewest neighbours next, neighbours of a contracted vertex become adjacent
+	// heap entries hold degrees as weights, outdated entries are skipped
+	const std::size_t V = rank.size();
+	std::vector<std::vector<std::uint32_t>> neighbours(V);
+	for(const auto& [u, v] : edges)
+	{
+		if(u == v)		continue;
+		neighbours[u].push_back(static_cast<std::uint32_t>(v));
+		neighbours[v].push_back(static_cast<std::uint32_t>(u));
+	}
+	std::priority_queue<Edge, std::vector<Edge>, Edge> heap;
+	for(std::size_t v = 0; v < V; ++v)
+	{
+		std::sort(neighbours[v].begin(), neighbours[v].end());
+		neighbours[v].erase(std::unique(neighbours[v].begin(), neighbours[v].end()), neighbours[v].end());
+		heap.push({v, static_cast<long long>(neighbours[v].size())});
+	}
+	std::vector<bool> contracted(V, false);
+	std::vector<std::uint32_t> merged;
+	std::size_t next_rank = 0;
+	while(heap.empty() == false)
+	{
+		const std::size_t v = heap.top().head;
+		const long long degree = heap.top().weight;
+		heap.pop();
+		if(contracted[v] == true || static_cast<std::size_t>(degree) != neighbours[v].size())		continue;
+		contracted[v] = true;
+		rank[v] = next_rank++;
+		for(const auto u : neighbours[v])
+		{	// neighbours lists are sorted and only contain vertices which are not contracted yet
+			merged.clear();
+			std::set_union(neighbours[u].begin(), neighbours[u].end(), neighbours[v].begin(), neighbours[v].end(), std::back_inserter(merged));
+			merged.erase(std::remove_if(merged.begin(), merged.end(), [&](const std::uint32_t w)
 			{
-				preprocessed.add_downward_edge(u, v.head, v.weight);
+				return w == u || w == v;
+			}), merged.end());
+			neighbours[u].swap(merged);
+			heap.push({u, static_cast<long long>(neighbours[u].size())});
+		}
+		std::vector<std::uint32_t>().swap(neighbours[v]);
+	}
+}
+
+CustomizableGraph::CustomizableGraph(const std::size_t V, const std::vector<std::pair<std::size_t, std::size_t>>& edges)
+	:	rank(V), edge_arcs(edges.size(), no_arc)
+{	// edges are (tail, head) pairs in input order, the weights given to customize follow the same order
+	order_by_minimum_degree(edges);
+	// arcs leaving each vertex towards higher and lower vertices, and arcs entering each vertex from higher vertices
+	std::vector<std::vector<std::pair<std::uint32_t, std::uint32_t>>> up(V), down(V), down_rev(V);
+	auto add_arc = [&](const std::uint32_t tail, const std::uint32_t head)
+	{
+		const std::uint32_t arc = static_cast<std::uint32_t>(arcs.size());
+		assert(arc != no_arc && "arc ids should fit into 32 bits");
+		arcs.push_back({tail, head});
+		if(tail < head)
+		{
+			up[tail].push_back({head, arc});
+		}
+		else
+		{
+			down[tail].push_back({head, arc});
+			down_rev[head].push_back({tail, arc});
+		}
+		return arc;
+	};
+	// parallel input edges share an arc
+	std::vector<std::size_t> order(edges.size());
+	std::iota(order.begin(), order.end(), 0);
+	auto renumbered = [&](const std::size_t e)
+	{
+		return std::make_pair(rank[edges[e].first], rank[edges[e].second]);
+	};
+	std::sort(order.begin(), order.end(), [&](const std::size_t lhs, const std::size_t rhs)
+	{
+		return renumbered(lhs) < renumbered(rhs);
+	});
+	for(std::size_t i = 0; i < order.size(); ++i)
+	{
+		const auto [tail, head] = renumbered(order[i]);
+		if(tail == head)		continue;
+		const bool is_new = (i == 0 || renumbered(order[i - 1]) != renumbered(order[i]));
+		edge_arcs[order[i]] = is_new ? add_arc(static_cast<std::uint32_t>(tail), static_cast<std::uint32_t>(head)) : edge_arcs[order[i - 1]];
+	}
+	// contract vertices in order without witness searches
+	std::vector<std::uint32_t> arc_to(V, no_arc);
+	for(std::uint32_t v = 0; v < V; ++v)
+	{
+		for(const auto& [u, first] : down_rev[v])
+		{	// mark arcs leaving u so that an existing u -> w is found in O(1)
+			for(const auto& [w, arc] : up[u])		arc_to[w] = arc;
+			for(const auto& [w, arc] : down[u])		arc_to[w] = arc;
+			for(const auto& [w, second] : up[v])
+			{
+				if(w == u)		continue;
+				if(arc_to[w] == no_arc)		arc_to[w] = add_arc(u, w);
+				triangles.push_back({first, second, arc_to[w]});
 			}
+			for(const auto& [w, arc] : up[u])		arc_to[w] = no_arc;
+			for(const auto& [w, arc] : down[u])		arc_to[w] = no_arc;
 		}
 	}
-	return preprocessed;
 }
 
-int main()
-{
-	std::size_t V, E;
-	std::cin >> V >> E;
+ContractedGraph CustomizableGraph::customize(const std::vector<long long>& weights) const
+{	// weights are given in the order of the input edges
+	// weight of an arc is final once the triangles below it are processed, and those come first in contraction order
+	// arc weights start from half of the range, so the sum of two of them never overflows
+	assert(weights.size() == edge_arcs.size() && "a weight is required for each edge");
+	const long long inf = std::numeric_limits<long long>::max() / 2;
+	std::vector<long long> arc_weights(arcs.size(), inf);
+	// middle nodes of the triangles which give the weights, arcs whose weight comes from an edge have none
+	std::vector<std::size_t> arc_middles(arcs.size(), Edge::none);
+	for(std::size_t e = 0; e < weights.size(); ++e)
+	{
+		if(edge_arcs[e] != no_arc)		arc_weights[edge_arcs[e]] = std::min(arc_weights[edge_arcs[e]], weights[e]);
+	}
+	for(const auto& triangle : triangles)
+	{
+		if(arc_weights[triangle.first] + arc_weights[triangle.second] < arc_weights[triangle.shortcut])
+		{	// head of the first arc is the lowest vertex of the triangle
+			arc_weights[triangle.shortcut] = arc_weights[triangle.first] + arc_weights[triangle.second];
+			arc_middles[triangle.shortcut] = arcs[triangle.first].head;
+		}
+	}
+	// arcs without any path below them are left out
+	const std::size_t V = rank.size();
+	representation_type upward_adj_list(V, std::vector<Edge>());
+	representation_type downward_rev_adj_list(V, std::vector<Edge>());
+	for(std::size_t arc = 0; arc < arcs.size(); ++arc)
+	{
+		if(arc_weights[arc] >= inf)		continue;
+		if(arcs[arc].tail < arcs[arc].head)
+		{
+			upward_adj_list[arcs[arc].tail].push_back({arcs[arc].head, arc_weights[arc], arc_middles[arc]});
+		}
+		else
+		{
+			downward_rev_adj_list[arcs[arc].head].push_back({arcs[arc].tail, arc_weights[arc], arc_middles[arc]});
+		}
+	}
+	return ContractedGraph(upward_adj_list, downward_rev_adj_list, rank);
+}
+
+void answer_queries_in_batch(const ContractedGraph& graph, const std::size_t threads)
+{	// reads the rest of the input at once, answers the queries on the given number of threads and writes the costs in input order
+	// each thread owns a workspace, the graph is shared since search does not modify it
+	// latency of each query is measured on its own thread, throughput over the whole batch
+	const std::string input(std::istreambuf_iterator<char>(std::cin), {});
+	const char* curr = input.c_str();
+	auto next_number = [&curr]()
+	{	// input only consists of non-negative integers separated by whitespace
+		char* end;
+		const std::size_t number = std::strtoul(curr, &end, 10);
+		curr = end;
+		return number;
+	};
+	const std::size_t Q = next_number();
+	std::vector<std::pair<std::size_t, std::size_t>> queries(Q);
+	for(auto& [u, v] : queries)
+	{
+		u = next_number() - 1;
+		v = next_number() - 1;
+	}
+	std::vector<long long> costs(Q);
+	std::vector<std::chrono::nanoseconds::rep> latencies(Q);
+	std::vector<QueryWorkspace> workspaces(std::max<std::size_t>(threads, 1));
+	auto start = std::chrono::steady_clock::now();
+	parallel_for(threads, Q, [&](std::size_t thread, std::size_t q)
+	{
+		auto query_start = std::chrono::steady_clock::now();
+		costs[q] = graph.search(queries[q].first, queries[q].second, workspaces[thread]);
+		latencies[q] = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - query_start).count();
+	});
+	auto stop = std::chrono::steady_clock::now();
+	// 20 characters fit any long long and the newline
+	std::string output(Q * 21, '\0');
+	char* out = output.data();
+	for(const auto cost : costs)
+	{
+		out = std::to_chars(out, output.data() + output.size(), cost).ptr;
+		*out++ = '\n';
+	}
+	std::cout.write(output.data(), out - output.data());
+	std::cout.flush();
+	auto percentile = [&latencies](const double p)
+	{	// latency below which the given fraction of queries finish, in microseconds
+		if(latencies.empty() == true)		return 0.0;
+		auto nth = latencies.begin() + static_cast<std::ptrdiff_t>(p * static_cast<double>(latencies.size() - 1));
+		std::nth_element(latencies.begin(), nth, latencies.end());
+		return static_cast<double>(*nth) / 1000;
+	};
+	const double seconds = std::chrono::duration<double>(stop - start).count();
+	std::cerr << "Answered " << Q << " queries in " << seconds * 1000 << " milliseconds using " << threads << " threads, "
+			  << static_cast<double>(Q) / std::max(seconds, 1e-9) << " queries per second\n";
+	std::cerr << "Latency p50 " << percentile(0.50) << " microseconds, p99 " << percentile(0.99) << " microseconds\n";
+}
+
+int main(int argc, char* argv[])
+{	// usage: contraction_hierarchies [--threads N] [--compare] [--witness-limits HOPS SETTLED] [--save PATH | --load PATH]
+	// --threads N contracts independent sets of nodes and computes distance tables on N threads
+	// --witness-limits bounds the edges and settled nodes of each witness search
+	// --compare additionally contracts a copy of the graph sequentially and reports the speedup
+	// --save writes the hierarchy to a file after preprocessing
+	// --load maps a hierarchy written by --save instead of preprocessing, then input starts with queries
+	// --table reads S sources and T targets (S s_1 ... s_S T t_1 ... t_T) instead of queries and prints an S x T distance table
+	// --one-to-all reads S sources (S s_1 ... s_S) instead of queries and prints the costs from each source to every vertex
+	// --customize builds a customizable hierarchy instead of preprocessing, then reads E new weights after the edges,
+	// updates the hierarchy with them and answers queries with the new weights
+	// --paths prints the vertices of a shortest path for each query instead of its cost, -1 when there is no path
+	// --path-cache N keeps up to N vertices of unpacked shortcuts for path queries
+	// --batch parses all queries first, answers them on the threads given by --threads and reports throughput and latency
+	// timings are written to std::cerr so that std::cout only contains answers
+	std::size_t threads = 1;
+	bool compare = false;
+	std::size_t hop_limit = 16, settled_limit = 1000;
+	std::string save_path, load_path;
+	bool table = false, one_to_all = false, customize = false, paths = false, batch = false;
+	std::size_t path_cache_capacity = 0;
+	for(int i = 1; i < argc; ++i)
+	{
+		const std::string option = argv[i];
+		if(option == "--threads" && i + 1 < argc)				threads = std::stoul(argv[++i]);
+		else if(option == "--compare")							compare = true;
+		else if(option == "--witness-limits" && i + 2 < argc)
+		{
+			hop_limit = std::stoul(argv[++i]);
+			settled_limit = std::stoul(argv[++i]);
+		}
+		else if(option == "--save" && i + 1 < argc)				save_path = argv[++i];
+		else if(option == "--load" && i + 1 < argc)				load_path = argv[++i];
+		else if(option == "--table")							table = true;
+		else if(option == "--one-to-all")						one_to_all = true;
+		else if(option == "--customize")						customize = true;
+		else if(option == "--paths")							paths = true;
+		else if(option == "--batch")							batch = true;
+		else if(option == "--path-cache" && i + 1 < argc)		path_cache_capacity = std::stoul(argv[++i]);
+	}
 	ContractedGraph preprocessed;
+	if(load_path.empty() == false)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		if(preprocessed.load(load_path) == false)
+		{
+			std::cerr << "Cannot load contraction hierarchy from " << load_path << "\n";
+			return 1;
+		}
+		auto stop = std::chrono::high_resolution_clock::now();
+		auto duration = std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count();
+		std::cerr << "Loaded " << preprocessed.size() << " vertices in " << duration << " microseconds\n";
+	}
+	else
 	{	// create roadmap inside a block so that after ContractedGraph is computed, memory is released
+		std::size_t V, E;
+		std::cin >> V >> E;
 		Graph roadmap(V);
+		roadmap.set_witness_limits(hop_limit, settled_limit);
 		std::size_t u, v;
 		long long w;
+		std::vector<std::pair<std::size_t, std::size_t>> edges;
+		std::vector<long long> weights;
 		for(std::size_t e = 0; e < E; ++e)
 		{
 			std::cin >> u >> v >> w;
-			roadmap.add_edge(u - 1, v - 1, w);
+			if(customize == true)
+			{
+				edges.push_back({u - 1, v - 1});
+				weights.push_back(w);
+			}
+			else
+			{
+				roadmap.add_edge(u - 1, v - 1, w);
+			}
 		}
-		preprocessed = roadmap.preprocess();
+		if(customize == true)
+		{	// second customization shows how fast the hierarchy follows changing weights
+			auto start = std::chrono::high_resolution_clock::now();
+			CustomizableGraph customizable(V, edges);
+			auto stop = std::chrono::high_resolution_clock::now();
+			std::cerr << "Built topology of " << customizable.arc_count() << " arcs and " << customizable.triangle_count() << " triangles in " 
+					  << std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count() << " milliseconds\n";
+			for(int round = 0; round < 2; ++round)
+			{
+				if(round == 1)
+				{
+					for(auto& weight : weights)		std::cin >> weight;
+				}
+				start = std::chrono::high_resolution_clock::now();
+				preprocessed = customizable.customize(weights);
+				stop = std::chrono::high_resolution_clock::now();
+				std::cerr << (round == 0 ? "Customized" : "Updated weights") << " in " 
+						  << std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count() << " milliseconds\n";
+			}
+		}
+		else
+		{
+			long long sequential_duration = 0;
+			if(compare == true)
+			{	// preprocess modifies the graph, that is why a copy is contracted
+				Graph copy = roadmap;
+				auto start = std::chrono::high_resolution_clock::now();
+				copy.preprocess();
+				auto stop = std::chrono::high_resolution_clock::now();
+				sequential_duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+			}
+			auto start = std::chrono::high_resolution_clock::now();
+			preprocessed = roadmap.preprocess(threads);
+			auto stop = std::chrono::high_resolution_clock::now();
+			auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+			std::cerr << "Preprocessed in " << duration << " milliseconds using " << threads << " threads\n";
+			if(compare == true)
+			{
+				std::cerr << "Sequential preprocessing took " << sequential_duration << " milliseconds, speedup is " 
+						  << static_cast<double>(sequential_duration) / std::max<long long>(duration, 1) << "\n";
+			}
+		}
+	}
+	if(preprocessed.valid() == false)
+	{
+		std::cerr << "Cannot build contraction hierarchy, weights should be between 0 and " << std::numeric_limits<std::uint32_t>::max() << "\n";
+		return 1;
+	}
+	if(save_path.empty() == false && preprocessed.save(save_path) == false)
+	{
+		std::cerr << "Cannot save contraction hierarchy to " << save_path << "\n";
+		return 1;
+	}
+	if(table == true)
+	{
+		std::size_t S, T;
+		std::cin >> S;
+		std::vector<std::size_t> sources(S);
+		for(auto& s : sources)
+		{
+			std::cin >> s;
+			--s;
+		}
+		std::cin >> T;
+		std::vector<std::size_t> targets(T);
+		for(auto& t : targets)
+		{
+			std::cin >> t;
+			--t;
+		}
+		auto start = std::chrono::high_resolution_clock::now();
+		auto costs = preprocessed.distance_table(sources, targets, threads);
+		auto stop = std::chrono::high_resolution_clock::now();
+		std::cerr << "Computed " << S << " x " << T << " distance table in " 
+				  << std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count() << " milliseconds\n";
+		for(std::size_t i = 0; i < S; ++i)
+		{
+			for(std::size_t j = 0; j < T; ++j)
+			{
+				std::cout << costs[i * T + j] << ((j + 1 == T) ? "\n" : " ");
+			}
+		}
+		return 0;
+	}
+	if(one_to_all == true)
+	{
+		std::size_t S;
+		std::cin >> S;
+		std::vector<std::size_t> sources(S);
+		for(auto& s : sources)
+		{
+			std::cin >> s;
+			--s;
+		}
+		auto start = std::chrono::high_resolution_clock::now();
+		auto costs = preprocessed.one_to_all(sources);
+		auto stop = std::chrono::high_resolution_clock::now();
+		std::cerr << "Computed costs from " << S << " sources to all vertices in " 
+				  << std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count() << " milliseconds\n";
+		const std::size_t V = preprocessed.size();
+		for(std::size_t i = 0; i < S; ++i)
+		{
+			for(std::size_t v = 0; v < V; ++v)
+			{
+				std::cout << costs[i * V + v] << ((v + 1 == V) ? "\n" : " ");
+			}
+		}
+		return 0;
+	}
+	if(batch == true)
+	{
+		answer_queries_in_batch(preprocessed, threads);
+		return 0;
 	}
 	std::size_t Q, u, v;
 	std::cin >> Q;
+	std::chrono::nanoseconds query_duration{0};
+	QueryWorkspace workspace;
+	workspace.set_path_cache_capacity(path_cache_capacity);
 	for(std::size_t q = 0; q < Q; ++q)
 	{
 		std::cin >> u >> v;
-		std::cout << preprocessed.search(u - 1, v - 1) << "\n";
+		if(paths == true)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			const auto vertices = preprocessed.path(u - 1, v - 1, workspace);
+			query_duration += std::chrono::high_resolution_clock::now() - start;
+			if(vertices.empty() == true)		std::cout << -1;
+			for(std::size_t i = 0; i < vertices.size(); ++i)
+			{
+				std::cout << vertices[i] + 1 << ((i + 1 == vertices.size()) ? "" : " ");
+			}
+			std::cout << "\n";
+			continue;
+		}
+		auto start = std::chrono::high_resolution_clock::now();
+		long long cost = preprocessed.search(u - 1, v - 1, workspace);
+		query_duration += std::chrono::high_resolution_clock::now() - start;
+		std::cout << cost << "\n";
 	}
+	std::cerr << "Answered " << Q << " queries in " << std::chrono::duration<double, std::micro>(query_duration).count() / std::max<std::size_t>(Q, 1) 
+			  << " microseconds on average\n";
 	return 0;
 }
@@ -6,52 +6,571 @@
 #include <string>
 #include <sstream>
 #include <limits>
+#include <chrono>
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
-struct Edge
-{	// v is the head of directed edge
-	// w is the weight of that edge
-	std::size_t v;
-	long long w;
-	bool operator()(const Edge& lhs, const Edge& rhs)
-	{	// this function is intended for min-heap data structure
-		return lhs.w > rhs.w;
-	}
-};
+#include "queues.hpp"
 
+using Edge = BasicEdge<std::size_t, long long>;
+// half the size of Edge, for graphs with less than 2^32 vertices and weights
+using CompactEdge = BasicEdge<std::uint32_t, std::uint32_t>;
 
-std::vector<double> dijkstra(const std::vector<std::vector<Edge>>& adj_list, const std::size_t s)
-{	// runs in O(m lgn) time due to min heap data structure
-	std::priority_queue<Edge, std::vector<Edge>, Edge> q;
+struct Counters
+{	// work done by a dijkstra run
+	// stale entries are popped after their vertex was settled with a smaller cost, the indexed heap leaves none
+	// before stale entries were skipped, their edges were relaxed again, skipped_relaxations counts those edges
+	std::size_t pops = 0;
+	std::size_t stale = 0;
+	std::size_t relaxations = 0;
+	std::size_t skipped_relaxations = 0;
+	// relaxations skipped because the cost would not fit into the distance type
+	std::size_t overflows = 0;
+};
+
+template<template<class> class Queue = BinaryHeap, class Distance = long long, class Vertex, class Weight>
+std::vector<Distance> dijkstra(const std::vector<std::vector<BasicEdge<Vertex, Weight>>>& adj_list, const std::size_t s, Counters* counters = nullptr)
+{	// runs in O(m lgn) time with BinaryHeap and IndexedHeap, O(m + n lgC) with RadixHeap and O(m + nC) with BucketQueue
+	// where C is the largest weight, weights should be non-negative integers
+	// the largest Distance stands for infinity, a path whose cost does not fit below it is not relaxed and is counted as an overflow
+	// with CompactEdge and 32-bit Distance, queue entries also take half the memory
+	// counters are optional and accumulate over calls
+	static_assert(std::numeric_limits<Distance>::max() >= std::numeric_limits<Weight>::max(), "Distance should hold any weight");
+	using Entry = BasicEdge<Vertex, Distance>;
+	Queue<Entry> q(adj_list);
 	std::size_t V = adj_list.size();
-	double inf = std::numeric_limits<double>::infinity();
-	std::vector<double> cost(V, inf);
+	const Distance inf = std::numeric_limits<Distance>::max();
+	std::vector<Distance> cost(V, inf);
 	// std::vector<bool> visited(V, false);
   	// std::vector<int> parent(V, -1);
 	// initialize for starting vertex
-	q.push({s, 0});
+	q.push(static_cast<Vertex>(s), 0);
 	cost[s] = 0;
+	Counters local_counters;
+	Counters& count = (counters == nullptr) ? local_counters : *counters;
 	while(q.empty() == false)
 	{
-		long long curr = q.top().v;
-		q.pop();
+		const Entry top = q.pop();
+		const std::size_t curr = top.v;
+		++count.pops;
+		if(top.w > cost[curr])
+		{	// skip the entries pushed before the cost of the vertex was decreased
+			++count.stale;
+			count.skipped_relaxations += adj_list[curr].size();
+			continue;
+		}
 		const auto& neighbours = adj_list[curr];
+		count.relaxations += neighbours.size();
 		for(const auto& neighbour : neighbours)
 		{
-			long long prospective_cost = cost[curr] + neighbour.w;
+			if(static_cast<Distance>(neighbour.w) >= inf - cost[curr])
+			{
+				++count.overflows;
+				continue;
+			}
+			const Distance prospective_cost = cost[curr] + static_cast<Distance>(neighbour.w);
 			if(prospective_cost < cost[neighbour.v])
 			{
 				cost[neighbour.v] = prospective_cost;
 				// parent[neighbour.v] = curr;
-				q.push({neighbour.v, prospective_cost});
+				q.push(neighbour.v, prospective_cost);
 			}
 		}
 	}
 	return cost;
 }
 
-int main() 
+template<template<class> class Queue = BinaryHeap, class Distance = long long, class Vertex = std::size_t> class Workspace
+{	// caller-owned state of point-to-point and multi-target dijkstra, sized for one graph and reused between queries
+	// a label is valid only when its stamp equals the version of the current query, otherwise its cost is infinite,
+	// so a query starts by incrementing the version instead of resetting V labels, and only touches what it explores
+	using Entry = BasicEdge<Vertex, Distance>;
+	public:
+	static constexpr Distance inf = std::numeric_limits<Distance>::max();
+	template<class AdjList> explicit Workspace(const AdjList& adj_list)	:	labels(adj_list.size()), target_mark(adj_list.size(), 0), q(adj_list)	{}
+	// shortest path from the source of the last query to v, empty when v was not reached
+	// only vertices settled by that query have final parents, which includes all of its targets
+	std::vector<Vertex> path(const std::size_t v) const
+	{
+		std::vector<Vertex> result;
+		if(cost(v) == inf)		return result;
+		for(std::size_t u = v; u != none; u = labels[u].parent)		result.push_back(static_cast<Vertex>(u));
+		std::reverse(result.begin(), result.end());
+		return result;
+	}
+	Distance cost(const std::size_t v) const
+	{
+		return (labels[v].stamp == version) ? labels[v].cost : inf;
+	}
+	private:
+	template<template<class> class Q, class D, class V, class Weight>
+	friend std::vector<D> dijkstra(const std::vector<std::vector<BasicEdge<V, Weight>>>&, const std::size_t, const std::vector<std::size_t>&, Workspace<Q, D, V>&, Counters*);
+	static constexpr Vertex none = std::numeric_limits<Vertex>::max();
+	struct Label
+	{	// kept together, so that relaxing an edge touches one cache line of the head
+		Distance cost;
+		Vertex parent;
+		std::uint32_t stamp = 0;
+	};
+	std::vector<Label> labels;
+	// target_mark[v] equals the version while v is a target which is not settled yet
+	std::vector<std::uint32_t> target_mark;
+	std::uint32_t version = 0;
+	Queue<Entry> q;
+	void start()
+	{	// stamps are cleared only when the version wraps around, once every 2^32 - 1 queries
+		q.clear();
+		if(++version == 0)
+		{
+			for(auto& label : labels)		label.stamp = 0;
+			std::fill(target_mark.begin(), target_mark.end(), 0);
+			version = 1;
+		}
+	}
+	void set(const std::size_t v, const Distance c, const Vertex parent)
+	{
+		labels[v] = {c, parent, version};
+	}
+};
+
+template<template<class> class Queue, class Distance, class Vertex, class Weight>
+std::vector<Distance> dijkstra(const std::vector<std::vector<BasicEdge<Vertex, Weight>>>& adj_list, const std::size_t s, 
+							   const std::vector<std::size_t>& targets, Workspace<Queue, Distance, Vertex>& workspace, Counters* counters = nullptr)
+{	// same search as above, but stops as soon as all targets are settled and returns their costs in the given order
+	// costs of unreachable targets are infinite, workspace.path(t) gives the path to a target until the next query
+	// with a single target, the search explores the ball of radius cost(s, t) instead of the whole graph
+	workspace.start();
+	auto& q = workspace.q;
+	const std::uint32_t version = workspace.version;
+	std::size_t remaining = 0;
+	for(const auto t : targets)
+	{
+		if(workspace.target_mark[t] != version)
+		{
+			workspace.target_mark[t] = version;
+			++remaining;
+		}
+	}
+	constexpr Distance inf = Workspace<Queue, Distance, Vertex>::inf;
+	workspace.set(s, 0, Workspace<Queue, Distance, Vertex>::none);
+	q.push(static_cast<Vertex>(s), 0);
+	Counters local_counters;
+	Counters& count = (counters == nullptr) ? local_counters : *counters;
+	while(remaining > 0 && q.empty() == false)
+	{
+		const auto top = q.pop();
+		const std::size_t curr = top.v;
+		const Distance curr_cost = workspace.cost(curr);
+		++count.pops;
+		if(top.w > curr_cost)
+		{	// skip the entries pushed before the cost of the vertex was decreased
+			++count.stale;
+			count.skipped_relaxations += adj_list[curr].size();
+			continue;
+		}
+		if(workspace.target_mark[curr] == version)
+		{	// curr is settled, the search ends with its last target before relaxing its edges
+			workspace.target_mark[curr] = 0;
+			if(--remaining == 0)		break;
+		}
+		const auto& neighbours = adj_list[curr];
+		count.relaxations += neighbours.size();
+		for(const auto& neighbour : neighbours)
+		{
+			if(static_cast<Distance>(neighbour.w) >= inf - curr_cost)
+			{
+				++count.overflows;
+				continue;
+			}
+			const Distance prospective_cost = curr_cost + static_cast<Distance>(neighbour.w);
+			if(prospective_cost < workspace.cost(neighbour.v))
+			{
+				workspace.set(neighbour.v, prospective_cost, static_cast<Vertex>(curr));
+				q.push(neighbour.v, prospective_cost);
+			}
+		}
+	}
+	// marks of unreachable targets are left behind, they never equal a later version
+	std::vector<Distance> result(targets.size());
+	std::transform(targets.begin(), targets.end(), result.begin(), [&](const std::size_t t)
+	{
+		return workspace.cost(t);
+	});
+	return result;
+}
+
+template<template<class> class Queue, class Distance, class Vertex, class Weight>
+Distance dijkstra(const std::vector<std::vector<BasicEdge<Vertex, Weight>>>& adj_list, const std::size_t s, const std::size_t t, 
+				  Workspace<Queue, Distance, Vertex>& workspace, Counters* counters = nullptr)
+{	// point-to-point query
+	return dijkstra(adj_list, s, std::vector<std::size_t>(1, t), workspace, counters)[0];
+}
+
+class Barrier
+{	// threads calling wait are blocked until all of them have called it, then it can be used again
+	public:
+	explicit Barrier(const std::size_t _count)	:	count{_count}	{}
+	void wait()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		const std::size_t arrival_generation = generation;
+		if(++arrived == count)
+		{
+			arrived = 0;
+			++generation;
+			condition.notify_all();
+			return;
+		}
+		condition.wait(lock, [&]()
+		{
+			return generation != arrival_generation;
+		});
+	}
+	private:
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::size_t count;
+	std::size_t arrived = 0;
+	std::size_t generation = 0;
+};
+
+template<class Function> void parallel_for(const std::size_t threads, const std::size_t count, Function&& function)
+{	// calls function(thread, i) for each i in [0, count) on the given number of threads
+	// indices are handed out in chunks through an atomic counter, so that threads with cheap indices take more of them
+	constexpr std::size_t chunk = 64;
+	std::atomic<std::size_t> next{0};
+	auto work = [&](const std::size_t thread)
+	{
+		for(std::size_t begin = next.fetch_add(chunk); begin < count; begin = next.fetch_add(chunk))
+		{
+			for(std::size_t i = begin; i < std::min(begin + chunk, count); ++i)		function(thread, i);
+		}
+	};
+	std::vector<std::thread> workers;
+	for(std::size_t thread = 1; thread < threads; ++thread)		workers.emplace_back(work, thread);
+	work(0);
+	for(auto& worker : workers)		worker.join();
+}
+
+template<class Distance, class Vertex, class Weight> class DeltaStepping
+{	// parallel single-source shortest paths giving the same costs as dijkstra, the largest Distance stands for infinity
+	// bucket i holds the vertices whose tentative cost is in [i delta, (i + 1) delta), buckets are emptied in increasing order
+	// edges lighter than delta may put a vertex back into the current bucket, so they are relaxed in phases until it stays empty,
+	// heavier edges only reach later buckets, so they are relaxed once for each vertex removed from the bucket afterwards
+	// vertices of a phase are relaxed in parallel and costs are decreased by atomic compare and swap
+	// edges are split into light and heavy ones once, then each search reuses the split and the buffers
+	static_assert(std::numeric_limits<Distance>::max() >= std::numeric_limits<Weight>::max(), "Distance should hold any weight");
+	using Edge = BasicEdge<Vertex, Weight>;
+	public:
+	// delta 0 selects delta from the weights
+	DeltaStepping(const std::vector<std::vector<Edge>>&, const std::size_t, const Weight = 0);
+	std::vector<Distance> search(const std::size_t);
+	Weight get_delta() const
+	{
+		return delta;
+	}
+	private:
+	static constexpr Distance inf = std::numeric_limits<Distance>::max();
+	static constexpr std::size_t never = std::numeric_limits<std::size_t>::max();
+	std::size_t V;
+	std::size_t threads;
+	Weight delta;
+	std::size_t bucket_count;
+	// light edges of v are edges[offsets[v]] ... edges[split[v] - 1], heavy ones follow them up to offsets[v + 1]
+	std::vector<std::size_t> offsets;
+	std::vector<std::size_t> split;
+	std::vector<Edge> edges;
+	std::vector<std::atomic<Distance>> cost;
+	// buckets[thread][i mod bucket_count] holds the vertices the thread moved to bucket i
+	std::vector<std::vector<std::vector<Vertex>>> buckets;
+	// vertices of the current phase, and the vertices removed from the current bucket whose heavy edges are relaxed at the end
+	std::vector<Vertex> frontier;
+	std::vector<Vertex> removed;
+	// phase in which each vertex was last added to the frontier and the bucket from which it was last removed
+	std::vector<std::size_t> frontier_phase;
+	std::vector<std::size_t> removed_bucket;
+	std::size_t phase = 0;
+	std::size_t bucket_of(const Distance c) const
+	{
+		return static_cast<std::size_t>(c / static_cast<Distance>(delta));
+	}
+	void gather(const std::size_t);
+	void relax(const std::size_t, const std::size_t, const bool);
+};
+
+template<class Vertex, class Weight> Weight automatic_delta(const std::vector<std::vector<BasicEdge<Vertex, Weight>>>& adj_list)
+{	// largest weight divided by average degree, as Meyer and Sanders suggest for random weights
+	// then a vertex has about one light edge, so a bucket is emptied in few phases while few relaxations are wasted
+	std::size_t edge_count = 0;
+	Weight max_weight = 0;
+	for(const auto& neighbours : adj_list)
+	{
+		edge_count += neighbours.size();
+		for(const auto& neighbour : neighbours)		max_weight = std::max(max_weight, neighbour.w);
+	}
+	const double average_degree = static_cast<double>(edge_count) / static_cast<double>(std::max<std::size_t>(adj_list.size(), 1));
+	return std::max<Weight>(1, static_cast<Weight>(static_cast<double>(max_weight) / std::max(average_degree, 1.0)));
+}
+
+template<class Distance, class Vertex, class Weight> 
+DeltaStepping<Distance, Vertex, Weight>::DeltaStepping(const std::vector<std::vector<Edge>>& adj_list, const std::size_t _threads, const Weight _delta)
+	:	V{adj_list.size()}, threads{std::max<std::size_t>(_threads, 1)}, delta{(_delta == 0) ? automatic_delta(adj_list) : _delta}, 
+		offsets(V + 1, 0), split(V), cost(V), frontier_phase(V, never), removed_bucket(V, never)
 {
-	std::ifstream file("dijkstraData.txt");							// 1 based
+	Weight max_weight = 0;
+	for(std::size_t v = 0; v < V; ++v)
+	{
+		offsets[v + 1] = offsets[v] + adj_list[v].size();
+		for(const auto& neighbour : adj_list[v])		max_weight = std::max(max_weight, neighbour.w);
+	}
+	// tentative costs are less than (current bucket + 1) delta + max weight, so that many buckets are used circularly
+	bucket_count = static_cast<std::size_t>(max_weight / delta) + 2;
+	buckets.assign(threads, std::vector<std::vector<Vertex>>(bucket_count));
+	edges.resize(offsets[V]);
+	parallel_for(threads, V, [&](std::size_t, std::size_t v)
+	{
+		auto light_end = std::copy_if(adj_list[v].begin(), adj_list[v].end(), edges.begin() + offsets[v], [this](const Edge& edge)
+		{
+			return edge.w < delta;
+		});
+		std::copy_if(adj_list[v].begin(), adj_list[v].end(), light_end, [this](const Edge& edge)
+		{
+			return edge.w >= delta;
+		});
+		split[v] = static_cast<std::size_t>(light_end - edges.begin());
+	});
+}
+
+template<class Distance, class Vertex, class Weight> void DeltaStepping<Distance, Vertex, Weight>::gather(const std::size_t index)
+{	// moves the vertices of bucket index into the frontier, entries of vertices which moved to a lower bucket are dropped
+	frontier.clear();
+	++phase;
+	for(auto& thread_buckets : buckets)
+	{
+		for(const auto v : thread_buckets[index % bucket_count])
+		{
+			if(bucket_of(cost[v].load(std::memory_order_relaxed)) != index || frontier_phase[v] == phase)		continue;
+			frontier_phase[v] = phase;
+			frontier.push_back(v);
+			if(removed_bucket[v] != index)
+			{
+				removed_bucket[v] = index;
+				removed.push_back(v);
+			}
+		}
+		thread_buckets[index % bucket_count].clear();
+	}
+}
+
+template<class Distance, class Vertex, class Weight> 
+void DeltaStepping<Distance, Vertex, Weight>::relax(const std::size_t thread, const std::size_t u, const bool heavy)
+{	// relaxes light or heavy edges of u, a vertex whose cost is decreased is appended to a bucket of the thread
+	const Distance c = cost[u].load(std::memory_order_relaxed);
+	const std::size_t first = heavy ? split[u] : offsets[u];
+	const std::size_t last = heavy ? offsets[u + 1] : split[u];
+	for(std::size_t e = first; e < last; ++e)
+	{
+		if(static_cast<Distance>(edges[e].w) >= inf - c)		continue;
+		const Distance candidate = c + static_cast<Distance>(edges[e].w);
+		auto& head_cost = cost[edges[e].v];
+		Distance old = head_cost.load(std::memory_order_relaxed);
+		while(candidate < old)
+		{	// a failed exchange reloads old, then the loop ends if another thread found a cheaper path
+			if(head_cost.compare_exchange_weak(old, candidate, std::memory_order_relaxed))
+			{
+				buckets[thread][bucket_of(candidate) % bucket_count].push_back(edges[e].v);
+				break;
+			}
+		}
+	}
+}
+
+template<class Distance, class Vertex, class Weight> std::vector<Distance> DeltaStepping<Distance, Vertex, Weight>::search(const std::size_t s)
+{	// threads run the same loop and meet at barriers, in between thread 0 selects the vertices of the next phase
+	// after light edges, the current bucket is relaxed again until it is empty, then heavy edges of its vertices follow
+	// after heavy edges, the next non-empty bucket is relaxed
+	for(auto& c : cost)		c.store(inf, std::memory_order_relaxed);
+	std::fill(removed_bucket.begin(), removed_bucket.end(), never);
+	cost[s].store(0, std::memory_order_relaxed);
+	frontier.assign(1, static_cast<Vertex>(s));
+	removed.assign(1, static_cast<Vertex>(s));
+	removed_bucket[s] = 0;
+	std::size_t current = 0;
+	bool heavy = false, finished = false;
+	auto advance = [&]()
+	{
+		if(heavy == false)
+		{
+			gather(current);
+			if(frontier.empty() == true)
+			{
+				heavy = true;
+				frontier.swap(removed);
+				removed.clear();
+			}
+			return;
+		}
+		heavy = false;
+		removed.clear();
+		finished = true;
+		for(std::size_t k = 1; k < bucket_count; ++k)
+		{
+			gather(current + k);
+			if(frontier.empty() == false)
+			{
+				current += k;
+				finished = false;
+				return;
+			}
+		}
+	};
+	constexpr std::size_t chunk = 64;
+	std::atomic<std::size_t> next{0};
+	Barrier barrier(threads);
+	auto work = [&](const std::size_t thread)
+	{
+		while(true)
+		{
+			for(std::size_t begin = next.fetch_add(chunk); begin < frontier.size(); begin = next.fetch_add(chunk))
+			{
+				for(std::size_t i = begin; i < std::min(begin + chunk, frontier.size()); ++i)		relax(thread, frontier[i], heavy);
+			}
+			barrier.wait();
+			if(thread == 0)
+			{
+				advance();
+				next.store(0);
+			}
+			barrier.wait();
+			if(finished == true)		return;
+		}
+	};
+	std::vector<std::thread> workers;
+	for(std::size_t thread = 1; thread < threads; ++thread)		workers.emplace_back(work, thread);
+	work(0);
+	for(auto& worker : workers)		worker.join();
+	std::vector<Distance> result(V);
+	for(std::size_t v = 0; v < V; ++v)		result[v] = cost[v].load(std::memory_order_relaxed);
+	return result;
+}
+
+template<class Distance = long long, class Vertex, class Weight>
+std::vector<Distance> delta_stepping(const std::vector<std::vector<BasicEdge<Vertex, Weight>>>& adj_list, const std::size_t s, const std::size_t threads, const Weight delta = 0)
+{	// single search, DeltaStepping should be kept for searches from several sources
+	return DeltaStepping<Distance, Vertex, Weight>(adj_list, threads, delta).search(s);
+}
+
+template<template<class> class Queue, class Distance = long long, class AdjList> 
+std::vector<long long> benchmark(const AdjList& adj_list, const std::size_t runs, const char* name)
+{	// runs dijkstra from vertices 0, 1, ..., runs - 1 and reports the average time and work
+	// returns costs from the last source, -1 when there is no path, so that results of different distance types can be compared
+	assert(runs > 0 && "times and work are averaged over the runs");
+	std::vector<Distance> cost;
+	Counters counters;
+	auto start = std::chrono::high_resolution_clock::now();
+	for(std::size_t s = 0; s < runs; ++s)
+	{
+		cost = dijkstra<Queue, Distance>(adj_list, s % adj_list.size(), &counters);
+	}
+	auto stop = std::chrono::high_resolution_clock::now();
+	std::cerr << name << ": " << std::chrono::duration<double, std::milli>(stop - start).count() / runs << " milliseconds per source, " 
+			  << counters.pops / runs << " pops, " << counters.stale / runs << " stale entries, " << counters.relaxations / runs << " relaxations, " 
+			  << counters.skipped_relaxations / runs << " redundant relaxations skipped per source\n";
+	if(counters.overflows > 0)		std::cerr << name << ": " << counters.overflows << " relaxations overflowed\n";
+	std::vector<long long> result(cost.size());
+	std::transform(cost.begin(), cost.end(), result.begin(), [](const Distance c)
+	{
+		return (c == std::numeric_limits<Distance>::max()) ? -1 : static_cast<long long>(c);
+	});
+	return result;
+}
+
+std::vector<long long> benchmark_delta_stepping(const std::vector<std::vector<Edge>>& adj_list, const std::size_t runs, const std::size_t threads, const long long delta)
+{	// runs delta-stepping from vertices 0, 1, ..., runs - 1 like benchmark does for dijkstra, splitting edges once
+	assert(runs > 0 && "times are averaged over the runs");
+	auto start = std::chrono::high_resolution_clock::now();
+	DeltaStepping<long long, std::size_t, long long> engine(adj_list, threads, delta);
+	auto stop = std::chrono::high_resolution_clock::now();
+	std::cerr << "delta-stepping split edges in " << std::chrono::duration<double, std::milli>(stop - start).count() << " milliseconds\n";
+	std::vector<long long> cost;
+	start = std::chrono::high_resolution_clock::now();
+	for(std::size_t s = 0; s < runs; ++s)
+	{
+		cost = engine.search(s % adj_list.size());
+	}
+	stop = std::chrono::high_resolution_clock::now();
+	std::cerr << "delta-stepping on " << threads << " threads with delta " << engine.get_delta() << ": " 
+			  << std::chrono::duration<double, std::milli>(stop - start).count() / runs << " milliseconds per source\n";
+	std::replace(cost.begin(), cost.end(), std::numeric_limits<long long>::max(), -1LL);
+	return cost;
+}
+
+bool benchmark_queries(const std::vector<std::vector<Edge>>& adj_list, const std::size_t runs, const std::size_t target_count)
+{	// queries from vertices 0, 1, ..., runs - 1 to target_count pseudo-random targets each, answered by full searches and by a workspace
+	// returns whether both give the same costs and the paths of the workspace add up to those costs
+	assert(runs > 0 && "paths of the last query are checked");
+	const std::size_t V = adj_list.size();
+	std::vector<std::vector<std::size_t>> targets(runs, std::vector<std::size_t>(target_count));
+	for(std::size_t s = 0; s < runs; ++s)
+	{
+		for(std::size_t i = 0; i < target_count; ++i)		targets[s][i] = (s * 7919 + i * 104729 + 13) % V;
+	}
+	std::vector<std::vector<long long>> expected(runs);
+	auto start = std::chrono::high_resolution_clock::now();
+	for(std::size_t s = 0; s < runs; ++s)
+	{
+		const auto cost = dijkstra(adj_list, s % V);
+		for(const auto t : targets[s])		expected[s].push_back(cost[t]);
+	}
+	auto stop = std::chrono::high_resolution_clock::now();
+	std::cerr << target_count << " targets by full search: " << std::chrono::duration<double, std::milli>(stop - start).count() / runs << " milliseconds per query\n";
+	Workspace<> workspace(adj_list);
+	Counters counters;
+	bool agree = true;
+	start = std::chrono::high_resolution_clock::now();
+	for(std::size_t s = 0; s < runs; ++s)
+	{
+		agree = agree && dijkstra(adj_list, s % V, targets[s], workspace, &counters) == expected[s];
+	}
+	stop = std::chrono::high_resolution_clock::now();
+	std::cerr << target_count << " targets by workspace: " << std::chrono::duration<double, std::milli>(stop - start).count() / runs << " milliseconds per query, " 
+			  << counters.pops / runs << " pops per query\n";
+	// paths of the last query
+	for(const auto t : targets[runs - 1])
+	{
+		const auto path = workspace.path(t);
+		long long length = 0;
+		for(std::size_t i = 1; i < path.size(); ++i)
+		{
+			long long weight = std::numeric_limits<long long>::max();
+			for(const auto& edge : adj_list[path[i - 1]])
+			{
+				if(edge.v == path[i])		weight = std::min(weight, edge.w);
+			}
+			length += weight;
+		}
+		agree = agree && (path.empty() == true || (path.front() == (runs - 1) % V && path.back() == t && length == workspace.cost(t)));
+	}
+	return agree;
+}
+
+int main(int argc, char* argv[]) 
+{	// usage: dijkstra [FILE [RUNS [THREADS [DELTA]]]]
+	// each queue runs dijkstra from the first RUNS vertices, times are written to std::cerr
+	// then delta-stepping runs on THREADS threads, DELTA 0 selects delta from the weights
+	// and queries to one and to eight targets per source are answered by full searches and by a workspace
+	std::ifstream file((argc > 1) ? argv[1] : "dijkstraData.txt");		// 1 based
+	const std::size_t runs = (argc > 2) ? std::stoul(argv[2]) : 1;
+	const std::size_t threads = (argc > 3) ? std::stoul(argv[3]) : 1;
+	const long long delta = (argc > 4) ? std::stoll(argv[4]) : 0;
+	if(runs == 0)
+	{	// the benchmarks average over the runs and the queries check the paths of the last one
+		std::cerr << "RUNS should be at least 1\n";
+		return 1;
+	}
 	std::size_t V;
 	file >> V;
 	std::string line;
@@ -72,8 +591,36 @@ int main()
 		}
 	}
 	file.close();
-	// compute shortest path distance from s to t (0-based)
+	// the same graph with 32-bit vertex ids and weights
+	std::vector<std::vector<CompactEdge>> compact_adj_list(V);
+	for(std::size_t u = 0; u < V; ++u)
+	{
+		for(const auto& edge : adj_list[u])
+		{
+			compact_adj_list[u].push_back({static_cast<std::uint32_t>(edge.v), static_cast<std::uint32_t>(edge.w)});
+		}
+	}
+	// compare the queues and types, all of them should find the same costs
+	// the bucket queue is left out when the weights are too large for it
+	const bool bucket_queue_fits = BucketQueue<Edge>::fits(adj_list);
+	if(bucket_queue_fits == false)		std::cerr << "bucket queue: weights larger than " << BucketQueue<Edge>::max_weight << ", skipped\n";
+	auto cost = benchmark<BinaryHeap>(adj_list, runs, "binary heap");
+	if(benchmark<RadixHeap>(adj_list, runs, "radix heap") != cost || 
+	   (bucket_queue_fits == true && benchmark<BucketQueue>(adj_list, runs, "bucket queue") != cost) || 
+	   benchmark<IndexedHeap>(adj_list, runs, "indexed 4-ary heap") != cost || 
+	   benchmark<BinaryHeap, std::uint32_t>(compact_adj_list, runs, "binary heap, 32-bit") != cost || 
+	   benchmark<IndexedHeap, std::uint32_t>(compact_adj_list, runs, "indexed 4-ary heap, 32-bit") != cost || 
+	   benchmark_delta_stepping(adj_list, runs, threads, delta) != cost || 
+	   benchmark_queries(adj_list, runs, 1) == false || benchmark_queries(adj_list, runs, 8) == false)
+	{
+		std::cerr << "queues disagree\n";
+		return 1;
+	}
+	// compute shortest path distance from s to t (0-based), inf when there is no path
 	long long s = 0, t = 6;									
-	std::cout << dijkstra(adj_list, s)[t] << "\n";				
+	Workspace<> workspace(adj_list);
+	const auto distance = dijkstra(adj_list, s, t, workspace);
+	if(distance == std::numeric_limits<long long>::max())		std::cout << "inf\n";
+	else														std::cout << distance << "\n";
 	return 0;
 }
@@ -0,0 +1,247 @@
+#ifndef GRAPH_SSSP_QUEUES_HPP
+#define GRAPH_SSSP_QUEUES_HPP
+
+// queue policies of dijkstra, shared by dijkstra.cpp and by johnson.cpp which runs dijkstra from every vertex
+// entries are (vertex, cost) pairs of the same form as the edges, so a BasicEdge serves as both
+
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <limits>
+#include <cassert>
+#include <cstddef>
+
+template<class Vertex, class Weight> struct BasicEdge
+{	// v is the head of directed edge
+	// w is the weight of that edge
+	// queues hold (vertex, cost) entries of the same form
+	Vertex v;
+	Weight w;
+	bool operator()(const BasicEdge& lhs, const BasicEdge& rhs)
+	{	// this function is intended for min-heap data structure
+		return lhs.w > rhs.w;
+	}
+};
+
+template<class Entry> class BinaryHeap
+{	// queue policies of dijkstra, each is created from the graph and holds (vertex, cost) entries as edges
+	// keys pushed by dijkstra are never less than the last popped key, the following two policies rely on that
+	// clear drops the entries left by a search which stopped early, so that a workspace can reuse the queue
+	using vertex_type = decltype(Entry::v);
+	using key_type = decltype(Entry::w);
+	public:
+	template<class AdjList> explicit BinaryHeap(const AdjList&) {}
+	bool empty() const
+	{
+		return q.empty();
+	}
+	void push(const vertex_type v, const key_type key)
+	{
+		q.push({v, key});
+	}
+	Entry pop()
+	{
+		const Entry top = q.top();
+		q.pop();
+		return top;
+	}
+	void clear()
+	{
+		q = decltype(q)();
+	}
+	private:
+	std::priority_queue<Entry, std::vector<Entry>, Entry> q;
+};
+
+template<class Entry> class RadixHeap
+{	// bucket 0 holds the keys equal to the last popped key,
+	// bucket i holds the keys whose highest bit differing from the last popped key is bit i - 1
+	// when bucket 0 is empty, the first non-empty bucket is redistributed around its minimum, so entries only move to lower buckets
+	// hence each entry moves at most 64 times, which is O(lg C) amortized per operation where C is the largest weight
+	using vertex_type = decltype(Entry::v);
+	using key_type = decltype(Entry::w);
+	public:
+	template<class AdjList> explicit RadixHeap(const AdjList&) {}
+	bool empty() const
+	{
+		return count == 0;
+	}
+	void push(const vertex_type v, const key_type key)
+	{
+		buckets[bucket(key)].push_back({v, key});
+		++count;
+	}
+	Entry pop()
+	{
+		if(buckets[0].empty() == true)
+		{
+			std::size_t i = 1;
+			while(buckets[i].empty() == true)		++i;
+			last = std::min_element(buckets[i].begin(), buckets[i].end(), [](const Entry& lhs, const Entry& rhs)
+			{
+				return lhs.w < rhs.w;
+			})->w;
+			for(const auto& entry : buckets[i])		buckets[bucket(entry.w)].push_back(entry);
+			buckets[i].clear();
+		}
+		const Entry top = buckets[0].back();
+		buckets[0].pop_back();
+		--count;
+		return top;
+	}
+	void clear()
+	{
+		for(auto& b : buckets)		b.clear();
+		last = 0;
+		count = 0;
+	}
+	private:
+	std::vector<Entry> buckets[65];
+	key_type last = 0;
+	std::size_t count = 0;
+	std::size_t bucket(const key_type key) const
+	{	// number of bits of key ^ last
+		const unsigned long long difference = static_cast<unsigned long long>(key) ^ static_cast<unsigned long long>(last);
+		return (difference == 0) ? 0 : 64 - __builtin_clzll(difference);
+	}
+};
+
+template<class Entry> class BucketQueue
+{	// dial's algorithm: keys in the queue are between the last popped key and that plus C, where C is the largest weight
+	// so key k is kept in bucket k mod (C + 1) and each bucket holds entries of a single key
+	// pop scans the buckets circularly from the last popped key, O(m + nC) in total, that is why it suits small weights only
+	using vertex_type = decltype(Entry::v);
+	using key_type = decltype(Entry::w);
+	public:
+	// C + 1 buckets are allocated and scanned, so larger weights are left to the other policies
+	static constexpr std::size_t max_weight = std::size_t{1} << 16;
+	template<class AdjList> explicit BucketQueue(const AdjList& adj_list)
+	{
+		assert(fits(adj_list) == true && "weights should not exceed max_weight");
+		buckets.resize(largest_weight(adj_list) + 1);
+	}
+	template<class AdjList> static bool fits(const AdjList& adj_list)
+	{	// whether the largest weight of the graph is small enough for a bucket queue
+		return largest_weight(adj_list) <= max_weight;
+	}
+	bool empty() const
+	{
+		return count == 0;
+	}
+	void push(const vertex_type v, const key_type key)
+	{
+		buckets[static_cast<std::size_t>(key) % buckets.size()].push_back({v, key});
+		++count;
+	}
+	Entry pop()
+	{
+		while(buckets[current].empty() == true)		current = (current + 1 == buckets.size()) ? 0 : current + 1;
+		const Entry top = buckets[current].back();
+		buckets[current].pop_back();
+		--count;
+		return top;
+	}
+	void clear()
+	{
+		for(auto& b : buckets)		b.clear();
+		current = 0;
+		count = 0;
+	}
+	private:
+	std::vector<std::vector<Entry>> buckets;
+	std::size_t current = 0;
+	std::size_t count = 0;
+	template<class AdjList> static std::size_t largest_weight(const AdjList& adj_list)
+	{
+		std::size_t largest = 0;
+		for(const auto& neighbours : adj_list)
+		{
+			for(const auto& neighbour : neighbours)		largest = std::max(largest, static_cast<std::size_t>(neighbour.w));
+		}
+		return largest;
+	}
+};
+
+template<class Entry> class IndexedHeap
+{	// 4-ary min heap in which each vertex has at most one entry, position[v] locates the entry of v
+	// pushing a vertex which is already in the heap decreases its key in place, so no stale entries are left behind
+	// hence the heap never holds more than V entries, and with four children per node it is half as deep as a binary heap
+	using vertex_type = decltype(Entry::v);
+	using key_type = decltype(Entry::w);
+	public:
+	template<class AdjList> explicit IndexedHeap(const AdjList& adj_list)	:	position(adj_list.size(), npos)	{}
+	bool empty() const
+	{
+		return heap.empty();
+	}
+	void push(const vertex_type v, const key_type key)
+	{	// inserts v or decreases its key, keys are never increased
+		if(position[v] == npos)
+		{
+			position[v] = static_cast<vertex_type>(heap.size());
+			heap.push_back({v, key});
+		}
+		else
+		{
+			heap[position[v]].w = key;
+		}
+		sift_up(position[v]);
+	}
+	Entry pop()
+	{
+		const Entry top = heap.front();
+		position[top.v] = npos;
+		heap.front() = heap.back();
+		heap.pop_back();
+		if(heap.empty() == false)		sift_down(0);
+		return top;
+	}
+	void clear()
+	{	// only the vertices left in the heap have positions to reset
+		for(const auto& entry : heap)		position[entry.v] = npos;
+		heap.clear();
+	}
+	private:
+	// positions are bounded by the number of vertices, so they share the type of vertex ids
+	static constexpr vertex_type npos = std::numeric_limits<vertex_type>::max();
+	std::vector<Entry> heap;
+	std::vector<vertex_type> position;
+	void place(const std::size_t i, const Entry& entry)
+	{
+		heap[i] = entry;
+		position[entry.v] = static_cast<vertex_type>(i);
+	}
+	void sift_up(std::size_t i)
+	{	// parents greater than the entry move down one level, then the entry is placed into the hole
+		const Entry entry = heap[i];
+		while(i > 0)
+		{
+			const std::size_t parent = (i - 1) / 4;
+			if(heap[parent].w <= entry.w)		break;
+			place(i, heap[parent]);
+			i = parent;
+		}
+		place(i, entry);
+	}
+	void sift_down(std::size_t i)
+	{	// the smallest child moves up one level while it is smaller than the entry
+		const Entry entry = heap[i];
+		const std::size_t size = heap.size();
+		while(4 * i + 1 < size)
+		{
+			const std::size_t first = 4 * i + 1;
+			const std::size_t last = std::min(first + 4, size);
+			std::size_t smallest = first;
+			for(std::size_t child = first + 1; child < last; ++child)
+			{
+				if(heap[child].w < heap[smallest].w)		smallest = child;
+			}
+			if(heap[smallest].w >= entry.w)		break;
+			place(i, heap[smallest]);
+			i = smallest;
+		}
+		place(i, entry);
+	}
+};
+
+#endif